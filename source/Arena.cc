@@ -0,0 +1,111 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/29 10:30
+ * @Description: Arena
+ * @FilePath: Bitplanes/source/Arena.cc
+ */
+#include "Arena.h"
+#include <cstdlib>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+NAMESPACE_BEGIN
+Arena::Arena(void *data, size_t size)
+  : data_(static_cast<uint8_t *>(data)), capacity_(data ? size : 0) {}
+
+Arena::~Arena() {
+  release();
+}
+
+Arena::Arena(Arena &&other) noexcept {
+  *this = std::move(other);
+}
+
+Arena &Arena::operator=(Arena &&other) noexcept {
+  if (this != &other) {
+    release();
+    std::swap(data_, other.data_);
+    std::swap(base_, other.base_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(mapped_, other.mapped_);
+    std::swap(used_, other.used_);
+    std::swap(huge_pages_, other.huge_pages_);
+  }
+  return *this;
+}
+
+bool Arena::reserve(size_t bytes, bool huge_pages) {
+  // 1.内存块足够大时直接复用
+  used_ = 0;
+  if (data_ && bytes <= capacity_)
+    return true;
+
+  release();
+  if (bytes == 0)
+    return true;
+
+#if defined(__linux__)
+  // 2.使用大页：先尝试预留的大页，失败时申请普通页并建议内核使用透明大页
+  if (huge_pages) {
+    const size_t size = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    huge_pages_ = p != MAP_FAILED;
+    if (!huge_pages_) {
+      p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#if defined(MADV_HUGEPAGE)
+      huge_pages_ = p != MAP_FAILED && madvise(p, size, MADV_HUGEPAGE) == 0;
+#endif
+    }
+
+    if (p != MAP_FAILED) {
+      base_ = p;
+      data_ = static_cast<uint8_t *>(p);
+      capacity_ = size;
+      mapped_ = size;
+      return true;
+    }
+    huge_pages_ = false;
+  }
+#endif
+
+  // 3.普通页：多申请ALIGNMENT字节用于对齐
+  base_ = std::malloc(bytes + ALIGNMENT);
+  if (!base_)
+    return false;
+  const auto addr = reinterpret_cast<uintptr_t>(base_);
+  data_ = reinterpret_cast<uint8_t *>((addr + ALIGNMENT - 1) & ~(uintptr_t) (ALIGNMENT - 1));
+  capacity_ = bytes;
+  return true;
+}
+
+void Arena::release() {
+#if defined(__linux__)
+  if (mapped_)
+    munmap(base_, mapped_);
+  else
+#endif
+    std::free(base_);
+
+  data_ = nullptr;
+  base_ = nullptr;
+  capacity_ = 0;
+  mapped_ = 0;
+  used_ = 0;
+  huge_pages_ = false;
+}
+
+void *Arena::allocate(size_t n) {
+  const size_t size = Bytes(n);
+  if (!data_ || size > capacity_ - used_)
+    return nullptr;
+
+  void *p = data_ + used_;
+  used_ += size;
+  return p;
+}
+
+NAMESPACE_END
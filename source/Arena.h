@@ -0,0 +1,121 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/29 10:12
+ * @Description: Arena
+ * @FilePath: Bitplanes/source/Arena.h
+ */
+#pragma once
+
+#include "API.h"
+#include <cstddef>
+#include <cstdint>
+
+NAMESPACE_BEGIN
+/**
+ * A single contiguous memory block from which buffers are handed out in order
+ * (bump allocation). Buffers are not freed individually; the whole block is
+ * released at once when the arena is destroyed or reserved again
+ */
+class Arena {
+public:
+  /**
+   * alignment of every buffer, one cache line
+   */
+  static constexpr size_t ALIGNMENT = 64;
+
+  /**
+   * size of the huge pages requested with 'huge_pages'
+   */
+  static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+  Arena() = default;
+
+  /**
+   * hands out buffers from memory owned by someone else, e.g. a buffer of
+   * another arena. The memory must be aligned to ALIGNMENT
+   *
+   * \param data the memory, nullptr gives an empty arena
+   * \param size its size in bytes
+   */
+  Arena(void *data, size_t size);
+
+  ~Arena();
+
+  Arena(Arena &&other) noexcept;
+
+  Arena &operator=(Arena &&other) noexcept;
+
+  Arena(const Arena &) = delete;
+
+  Arena &operator=(const Arena &) = delete;
+
+  /**
+   * \return bytes taken by a buffer of n bytes, including its alignment
+   */
+  static inline size_t Bytes(size_t n) {
+    return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  }
+
+  /**
+   * \return bytes taken by a buffer of n elements of type T
+   */
+  template<class T>
+  static inline size_t Bytes(size_t n) { return Bytes(n * sizeof(T)); }
+
+  /**
+   * makes room for at least 'bytes' bytes and discards all buffers handed out
+   * so far. The block is re-allocated only if it is too small
+   *
+   * \param bytes the size of the block
+   * \param huge_pages back the block with huge pages when the system supports
+   * them, otherwise regular pages are used
+   * \return false if the memory could not be allocated
+   */
+  bool reserve(size_t bytes, bool huge_pages = false);
+
+  /**
+   * frees the block
+   */
+  void release();
+
+  /**
+   * \return an aligned buffer of n bytes, nullptr if the arena is exhausted
+   */
+  void *allocate(size_t n);
+
+  /**
+   * \return an aligned buffer of n elements of type T, nullptr if the arena is
+   * exhausted. The elements are not constructed
+   */
+  template<class T>
+  inline T *allocate(size_t n) { return static_cast<T *>(allocate(n * sizeof(T))); }
+
+  inline size_t capacity() const { return capacity_; }
+
+  inline size_t used() const { return used_; }
+
+  inline size_t remaining() const { return capacity_ - used_; }
+
+  /**
+   * \return true if the block is backed by huge pages
+   */
+  inline bool hugePages() const { return huge_pages_; }
+
+  /**
+   * \return true if p points inside the block
+   */
+  inline bool contains(const void *p) const {
+    return data_ && p >= data_ && p < data_ + capacity_;
+  }
+
+private:
+  uint8_t *data_ = nullptr;   //< the aligned block
+  void *base_ = nullptr;      //< the pointer to free, nullptr if not owned
+  size_t capacity_ = 0;       //< usable size of the block
+  size_t mapped_ = 0;         //< size of the mapping if mmap'ed, 0 otherwise
+  size_t used_ = 0;           //< bytes handed out so far
+  bool huge_pages_ = false;   //< the block is backed by huge pages
+};
+
+NAMESPACE_END
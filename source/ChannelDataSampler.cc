@@ -8,181 +8,615 @@
 #include "ChannelDataSampler.h"
 #include "MotionModel.h"
 #include "LBP.h"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <new>
 #include <stdio.h>
 
 NAMESPACE_BEGIN
-static inline int getNumValid(const cv::Rect &roi, int s) {
-  int ret = 0;
+static inline int getNumValid(const cv::Rect &roi, const cv::Mat &mask, int s) {
+  // 去掉1个像素的边界后，每行每列按s采样，有掩码时只计掩码内的采样点
+  if (roi.width <= 2 || roi.height <= 2)
+    return 0;
+  if (mask.empty())
+    return ((roi.width - 2 + s - 1) / s) * ((roi.height - 2 + s - 1) / s);
+
+  assert(mask.type() == CV_8UC1 && mask.size() == roi.size());
+  int n = 0;
   for (int y = 1; y < roi.height - 1; y += s) {
-    for (int x = 1; x < roi.width - 1; x += s) {
-      ++ret;
-    }
+    const auto *m_row = mask.ptr<const uint8_t>(y);
+    for (int x = 1; x < roi.width - 1; x += s)
+      n += m_row[x] != 0;
   }
-  return ret;
+  return n;
+}
+
+template<class M>
+int ChannelDataSampler<M>::NumPixels(const cv::Rect &roi, const cv::Mat &mask) const {
+  return getNumValid(roi, mask, sub_sampling_);
 }
 
 template<class M>
-void ChannelDataSampler<M>::set(const cv::Mat &src, const cv::Rect &roi, float s, float c1, float c2) {
+size_t ChannelDataSampler<M>::BufferSize(const cv::Rect &roi, const cv::Mat &mask) const {
+  const size_t n_valid = NumPixels(roi, mask);
+  return Arena::Bytes<float>(8 * n_valid * M::DOF) + Arena::Bytes<uint8_t>(n_valid);
+}
+
+/**
+ * number of rows of the sampling grid processed by one task of set
+ */
+static constexpr int ROWS_PER_STRIPE = 8;
+
+/**
+ * computes the jacobian rows of the 8 channels of a template pixel from the
+ * LBP signatures of its right, left, bottom and top neighbors
+ *
+ * \return the sum over the channels of the outer products of the channel
+ * gradients S, such that J^T * J = Jw^T * S * Jw
+ */
+template<class WarpJacobian, class Rows>
+static inline
+Matrix22f ChannelJacobian(uint8_t cx1, uint8_t cx2, uint8_t cy1, uint8_t cy2,
+                          const WarpJacobian &Jw, Rows &&J) {
+  Matrix22f S = Matrix22f::Zero();
+  for (int b = 0; b < 8; ++b) {
+    const float gx = 0.5f * (static_cast<float>((cx1 >> b) & 1) - static_cast<float>((cx2 >> b) & 1));
+    const float gy = 0.5f * (static_cast<float>((cy1 >> b) & 1) - static_cast<float>((cy2 >> b) & 1));
+    J.row(b) = gx * Jw.row(0) + gy * Jw.row(1);
+    S(0, 0) += gx * gx;
+    S(0, 1) += gx * gy;
+    S(1, 1) += gy * gy;
+  }
+  S(1, 0) = S(0, 1);
+  return S;
+}
+
+template<class M>
+void ChannelDataSampler<M>::set(const cv::Mat &src, const cv::Rect &roi, Arena &arena,
+                                float s, float c1, float c2, const cv::Mat &mask) {
   assert(roi.x >= 1 || roi.x <= src.cols - 1 || roi.y >= 1 || roi.y <= src.rows - 1);
   assert(s > 0);
+  assert(mask.empty() || (mask.type() == CV_8UC1 && mask.size() == roi.size()));
+  assert(arena.remaining() >= BufferSize(roi, mask));
 
-  // 1.计算采样后，有效像素点数目
-  auto n_valid = getNumValid(roi, sub_sampling_);
+  // 1.划分采样网格上的分块与掩码内像素的行段，得到有效像素点数目
+  const int ss = sub_sampling_;
+  const int nx = std::max(0, (roi.width - 2 + ss - 1) / ss), ny = std::max(0, (roi.height - 2 + ss - 1) / ss);
+  SetTileLayout(nx, ny);
+  const int n_valid = SetRuns(nx, ny, mask);
 
-  // 2.像素点数组和对应雅可比矩阵数组
-  pixels_.resize(n_valid);
-  jacobian_.resize(8 * n_valid, M::DOF);
+  // 2.在内存池中分配像素点数组和对应雅可比矩阵数组
+  new(&jacobian_) JacobianMap(arena.allocate<float>(8 * n_valid * M::DOF), 8 * n_valid, M::DOF);
+  new(&pixels_) Pixels(arena.allocate<uint8_t>(n_valid), n_valid);
 
   // 3.计算ROI对应每个像素的LBP特征
   cv::Mat lbp;
   simd::LBP(src, roi, lbp);
-  int stride = lbp.cols;
-
-  /**
-   * compute the channel x- and y-gradient at col:=x for bit:=b
-   */
-  // 4.计算每个像素在X，Y方向梯度：按位取出
-  auto G = [=](const uint8_t *p, int x, int b) {
-    auto ix1 = static_cast<float>((p[x + 1] & (1 << b)) >> b), ix2 = static_cast<float>((p[x - 1] & (1 << b)) >> b),
-      iy1 = static_cast<float>((p[x + stride] & (1 << b)) >> b), iy2 = static_cast<float>((p[x - stride] & (1 << b)) >> b);
-    return Eigen::Matrix<float, 1, 2>(0.5f * (ix1 - ix2), 0.5f * (iy1 - iy2));
-  };
+  const auto stride = static_cast<int>(lbp.step[0]);
 
-  // 5.计算雅可比矩阵
-  typename M::WarpJacobian Jw;
+  // 4.按行分块并行计算雅可比矩阵，同时累加每块的海塞矩阵 H = sum(Jw^T * S * Jw)
+  const int n_stripes = (ny + ROWS_PER_STRIPE - 1) / ROWS_PER_STRIPE;
+  typename EigenStdVector<Hessian>::type partial(n_stripes, Hessian::Zero());
   auto *pixels_ptr = pixels_.data();
-  for (int y = 1, j = 0, i = 0; y < lbp.rows - 1; y += sub_sampling_) {
-    const auto *s_row = lbp.ptr<const uint8_t>(y);
-    for (int x = 1; x < lbp.cols - 1; x += sub_sampling_, i += 8, ++j) {
-      Jw = M::ComputeWarpJacobian(x + roi.x, y + roi.y, s, c1, c2);
-      pixels_ptr[j] = s_row[x];
-      jacobian_.row(i + 0) = G(s_row, x, 0) * Jw;
-      jacobian_.row(i + 1) = G(s_row, x, 1) * Jw;
-      jacobian_.row(i + 2) = G(s_row, x, 2) * Jw;
-      jacobian_.row(i + 3) = G(s_row, x, 3) * Jw;
-      jacobian_.row(i + 4) = G(s_row, x, 4) * Jw;
-      jacobian_.row(i + 5) = G(s_row, x, 5) * Jw;
-      jacobian_.row(i + 6) = G(s_row, x, 6) * Jw;
-      jacobian_.row(i + 7) = G(s_row, x, 7) * Jw;
+  cv::parallel_for_(cv::Range(0, n_stripes), [&](const cv::Range &range) {
+    typename M::WarpJacobian Jw;
+    for (int k = range.start; k < range.end; ++k) {
+      Hessian H = Hessian::Zero();
+      const int ky_end = std::min(ny, (k + 1) * ROWS_PER_STRIPE);
+      for (int ky = k * ROWS_PER_STRIPE; ky < ky_end; ++ky) {
+        const int y = 1 + ky * ss;
+        const auto *s_row = lbp.ptr<const uint8_t>(y);
+        for (int k_run = row_runs_[ky]; k_run < row_runs_[ky + 1]; ++k_run) {
+          const Run &run = runs_[k_run];
+          for (int kx = run.kx0, x = 1 + kx * ss, j = run.index; kx < run.kx1; ++kx, x += ss, ++j) {
+            const uint8_t *p = s_row + x;
+            Jw = M::ComputeWarpJacobian(x + roi.x, y + roi.y, s, c1, c2);
+            pixels_ptr[j] = *p;
+            const Matrix22f S = ChannelJacobian(p[1], p[-1], p[stride], p[-stride], Jw,
+                                                jacobian_.template block<8, M::DOF>(8 * j, 0));
+            H.noalias() += Jw.transpose() * S * Jw;
+          }
+        }
+      }
+      partial[k] = H;
     }
-  }
+  });
 
-  // 6.计算海塞矩阵
-  hessian_ = jacobian_.transpose() * jacobian_;
+  // 5.按固定顺序合并各块的海塞矩阵，结果与线程数无关
+  hessian_.setZero();
+  for (const auto &H : partial)
+    hessian_ += H;
   roi_stride_ = roi.width;
+  ComputeTileHessians(0, nx - 1, 0, ny - 1);
+  roi_ = roi;
+  scale_ = s;
+  c1_ = c1;
+  c2_ = c2;
+  num_updated_ = 0;
+}
+
+/**
+ * LBP signature of the pixel at p, same as simd::LBP
+ */
+static inline uint8_t LBPCode(const uint8_t *p, int stride) {
+  return static_cast<uint8_t>(
+    ((*(p - stride - 1) >= *p) << 0) |
+    ((*(p - stride) >= *p) << 1) |
+    ((*(p - stride + 1) >= *p) << 2) |
+    ((*(p - 1) >= *p) << 3) |
+    ((*(p + 1) >= *p) << 4) |
+    ((*(p + stride - 1) >= *p) << 5) |
+    ((*(p + stride) >= *p) << 6) |
+    ((*(p + stride + 1) >= *p) << 7));
+}
+
+template<class M>
+void ChannelDataSampler<M>::shareFrom(const ChannelDataSampler &other) {
+  // 1.Map的赋值会复制数据，用placement new将视图重新绑定到other的内存
+  new(&jacobian_) JacobianMap(other.jacobian_);
+  new(&pixels_) Pixels(other.pixels_);
+
+  // 2.其余成员直接赋值，vector复用已有的容量
+  hessian_ = other.hessian_;
+  sub_sampling_ = other.sub_sampling_;
+  roi_stride_ = other.roi_stride_;
+  roi_ = other.roi_;
+  scale_ = other.scale_;
+  c1_ = other.c1_;
+  c2_ = other.c2_;
+  num_updated_ = other.num_updated_;
+  tile_size_ = other.tile_size_;
+  tile_w_ = other.tile_w_;
+  tile_h_ = other.tile_h_;
+  tile_cols_ = other.tile_cols_;
+  tile_rows_ = other.tile_rows_;
+  tile_hessians_ = other.tile_hessians_;
+  tile_pixels_ = other.tile_pixels_;
+  runs_ = other.runs_;
+  row_runs_ = other.row_runs_;
 }
 
 template<class M>
-void ChannelDataSampler<M>::ComputeResiduals(const cv::Mat &Iw, Residuals &residuals) const {
-  typedef int8_t CType;
-  cv::AutoBuffer<CType> buf(8 * pixels_.size());
-  CType *r_ptr = buf;
+int ChannelDataSampler<M>::update(const cv::Mat &src, const cv::Point &origin, const cv::Rect &region) {
+  assert(src.type() == CV_8UC1);
+
+  // 1.更新区域与模板中有效采样区域的交集
+  const int s = sub_sampling_;
+  const cv::Rect r = region & cv::Rect(roi_.x + 1, roi_.y + 1, roi_.width - 2, roi_.height - 2);
+  if (r.area() <= 0)
+    return 0;
+  assert((cv::Rect(r.x - 2, r.y - 2, r.width + 4, r.height + 4) & cv::Rect(origin, src.size())) ==
+         cv::Rect(r.x - 2, r.y - 2, r.width + 4, r.height + 4));
+
+  // 2.区域内采样点在采样网格上的范围
+  const int kx0 = (r.x - roi_.x - 1 + s - 1) / s, kx1 = (r.x + r.width - 1 - roi_.x - 1) / s;
+  const int ky0 = (r.y - roi_.y - 1 + s - 1) / s, ky1 = (r.y + r.height - 1 - roi_.y - 1) / s;
+  if (kx0 > kx1 || ky0 > ky1)
+    return 0;
+
+  const auto stride = static_cast<int>(src.step[0]);
+
+  // 3.重新计算区域内每个模板像素的LBP特征与雅可比矩阵，海塞矩阵减去旧的贡献加上新的贡献
+  Hessian dH = Hessian::Zero();
+  Eigen::Matrix<float, 8, M::DOF> J;
+  typename M::WarpJacobian Jw;
+  int n = 0;
+  for (int ky = ky0; ky <= ky1; ++ky) {
+    const int y = roi_.y + 1 + ky * s;
+    for (int k_run = row_runs_[ky]; k_run < row_runs_[ky + 1]; ++k_run) {
+      const Run &run = runs_[k_run];
+      const int kx_begin = std::max(kx0, run.kx0), kx_end = std::min(kx1 + 1, run.kx1);
+      for (int kx = kx_begin; kx < kx_end; ++kx) {
+        const int x = roi_.x + 1 + kx * s, j = run.index + kx - run.kx0;
+        const uint8_t *p = src.ptr<const uint8_t>(y - origin.y) + (x - origin.x);
+
+        Jw = M::ComputeWarpJacobian(x, y, scale_, c1_, c2_);
+        const Matrix22f S = ChannelJacobian(LBPCode(p + 1, stride), LBPCode(p - 1, stride),
+                                            LBPCode(p + stride, stride), LBPCode(p - stride, stride), Jw, J);
+
+        auto J_old = jacobian_.template block<8, M::DOF>(8 * j, 0);
+        dH.noalias() -= J_old.transpose() * J_old;
+        dH.noalias() += Jw.transpose() * S * Jw;
+        J_old = J;
+        pixels_[j] = LBPCode(p, stride);
+      }
+      n += std::max(0, kx_end - kx_begin);
+    }
+  }
+  if (n == 0)
+    return 0;
+
+  // 4.累计更新的像素达到模板大小时重新完整计算，避免舍入误差累积
+  num_updated_ += n;
+  if (num_updated_ >= static_cast<size_t>(pixels_.size())) {
+    hessian_ = jacobian_.transpose() * jacobian_;
+    num_updated_ = 0;
+  } else {
+    hessian_ += dH;
+  }
+  ComputeTileHessians(kx0, kx1, ky0, ky1);
+  return n;
+}
 
-  // 1.计算LBP描述子之间残差
-  const uint8_t *c0_ptr = pixels_.data();
-  const int src_stride = Iw.cols;
-  for (int y = 1; y < Iw.rows - 1; y += sub_sampling_) {
-    const auto *s_row = Iw.ptr<const uint8_t>(y);
+template<class M>
+void ChannelDataSampler<M>::SetTileLayout(int nx, int ny) {
+  // 分块大小换算到采样网格上，不分块时整个模板为一块
+  const int ss = sub_sampling_;
+  tile_w_ = tile_size_ > 0 ? std::max(1, (tile_size_ + ss - 1) / ss) : std::max(1, nx);
+  tile_h_ = tile_size_ > 0 ? tile_w_ : std::max(1, ny);
+  tile_cols_ = std::max(1, (nx + tile_w_ - 1) / tile_w_);
+  tile_rows_ = std::max(1, (ny + tile_h_ - 1) / tile_h_);
+  tile_hessians_.assign(numTiles(), Hessian::Zero());
+}
 
-#pragma omp simd
-    for (int x = 1; x < Iw.cols - 1; x += sub_sampling_) {
-      const uint8_t *p = s_row + x;
-      const uint8_t c = *c0_ptr++;
-      *r_ptr++ = (*(p - src_stride - 1) >= *p) - ((c & (1 << 0)) >> 0);
-      *r_ptr++ = (*(p - src_stride) >= *p) - ((c & (1 << 1)) >> 1);
-      *r_ptr++ = (*(p - src_stride + 1) >= *p) - ((c & (1 << 2)) >> 2);
-      *r_ptr++ = (*(p - 1) >= *p) - ((c & (1 << 3)) >> 3);
-      *r_ptr++ = (*(p + 1) >= *p) - ((c & (1 << 4)) >> 4);
-      *r_ptr++ = (*(p + src_stride - 1) >= *p) - ((c & (1 << 5)) >> 5);
-      *r_ptr++ = (*(p + src_stride) >= *p) - ((c & (1 << 6)) >> 6);
-      *r_ptr++ = (*(p + src_stride + 1) >= *p) - ((c & (1 << 7)) >> 7);
+template<class M>
+int ChannelDataSampler<M>::SetRuns(int nx, int ny, const cv::Mat &mask) {
+  // 每行掩码内连续的采样点为一段，段在分块的列边界处断开，每段只属于一个分块
+  const int ss = sub_sampling_;
+  runs_.clear();
+  row_runs_.assign(ny + 1, 0);
+  tile_pixels_.assign(numTiles(), 0);
+  int n = 0;
+  for (int ky = 0; ky < ny; ++ky) {
+    row_runs_[ky] = static_cast<int>(runs_.size());
+    const uint8_t *m_row = mask.empty() ? nullptr : mask.ptr<const uint8_t>(1 + ky * ss);
+    auto inside = [&](int kx) { return !m_row || m_row[1 + kx * ss] != 0; };
+
+    for (int kx = 0; kx < nx;) {
+      if (!inside(kx)) {
+        ++kx;
+        continue;
+      }
+      const int kx_tile_end = std::min(nx, (kx / tile_w_ + 1) * tile_w_);
+      int kx1 = kx + 1;
+      while (kx1 < kx_tile_end && inside(kx1))
+        ++kx1;
+
+      const int tile = (ky / tile_h_) * tile_cols_ + kx / tile_w_;
+      runs_.push_back(Run{ky, kx, kx1, n, tile});
+      tile_pixels_[tile] += kx1 - kx;
+      n += kx1 - kx;
+      kx = kx1;
     }
   }
+  row_runs_[ny] = static_cast<int>(runs_.size());
+  return n;
+}
 
-  // 2.将残差返回
-  using namespace Eigen;
-  residuals = Map<Vector_<CType>, Aligned>(buf, pixels_.size() * 8, 1).template cast<float>();
+template<class M>
+void ChannelDataSampler<M>::ComputeTileHessians(int kx0, int kx1, int ky0, int ky1) {
+  // 只有一块时就是整个海塞矩阵
+  if (numTiles() == 1) {
+    tile_hessians_[0] = hessian_;
+    return;
+  }
+
+  // 每块的海塞矩阵由块内各段连续的雅可比矩阵行累加得到，各块并行计算
+  const int ny = static_cast<int>(row_runs_.size()) - 1;
+  const int tx0 = kx0 / tile_w_, tx1 = kx1 / tile_w_, ty0 = ky0 / tile_h_, ty1 = ky1 / tile_h_;
+  const int n = tx1 - tx0 + 1;
+  cv::parallel_for_(cv::Range(0, n * (ty1 - ty0 + 1)), [&](const cv::Range &range) {
+    for (int k = range.start; k < range.end; ++k) {
+      const int tx = tx0 + k % n, ty = ty0 + k / n, t = ty * tile_cols_ + tx;
+      Hessian H = Hessian::Zero();
+      const int k_end = row_runs_[std::min(ny, (ty + 1) * tile_h_)];
+      for (int k_run = row_runs_[ty * tile_h_]; k_run < k_end; ++k_run) {
+        const Run &run = runs_[k_run];
+        if (run.tile != t)
+          continue;
+        const auto J = jacobian_.middleRows(8 * run.index, 8 * (run.kx1 - run.kx0));
+        H.noalias() += J.transpose() * J;
+      }
+      tile_hessians_[t] = H;
+    }
+  });
+}
+
+/**
+ * clips the columns [kx0, kx1) of a row of the sampling grid to its visible
+ * columns c[0], c[1], see VisibleColumns
+ *
+ * \param a first visible column
+ * \param b end of the visible columns, a <= b <= kx1
+ */
+static inline void ClipColumns(int kx0, int kx1, const int *c, int &a, int &b) {
+  if (!c) {
+    a = kx0;
+    b = kx1;
+    return;
+  }
+  a = std::min(kx1, std::max(kx0, c[0]));
+  b = std::max(a, std::min(kx1, c[1]));
 }
 
 template<class M>
-float ChannelDataSampler<M>::DoLinearize(const cv::Mat &Iw, Gradient &g) const {
-  g.setZero();
-  float ret = 0.0f;
-
-  const uint8_t *c0_ptr = pixels_.data();
-  const int src_stride = Iw.cols;
-
-  for (int y = 1, i = 0; y < Iw.rows - 1; y += sub_sampling_) {
-    const auto srow = Iw.ptr<const uint8_t>(y);
-    for (int x = 1; x < Iw.cols - 1; x += sub_sampling_, i += 8) {
-      const auto *p = srow + x;
-      const auto *p0 = p - src_stride;
-      const auto *p1 = p + src_stride;
-
-      const auto c = *c0_ptr++;
-
-      Eigen::Matrix<float, 8, 1> err;
-      err[0] = static_cast<float>((p0[-1] > *p) - ((c & (1 << 0)) >> 0));
-      err[1] = static_cast<float>((p0[0] > *p) - ((c & (1 << 1)) >> 1));
-      err[2] = static_cast<float>((p0[1] > *p) - ((c & (1 << 2)) >> 2));
-      err[3] = static_cast<float>((p[-1] > *p) - ((c & (1 << 3)) >> 3));
-      err[4] = static_cast<float>((p[0] > *p) - ((c & (1 << 4)) >> 4));
-      err[5] = static_cast<float>((p1[-1] > *p) - ((c & (1 << 5)) >> 5));
-      err[6] = static_cast<float>((p1[0] > *p) - ((c & (1 << 6)) >> 6));
-      err[7] = static_cast<float>((p1[1] > *p) - ((c & (1 << 7)) >> 7));
-
-      g.noalias() += jacobian_.template block<8, 8>(i, 0) * err;
-      ret += err.squaredNorm();
+int ChannelDataSampler<M>::VisibleColumns(const int *bounds, int *cols) const {
+  // 采样点及LBP需要的上下左右各1个像素都在图像内插值得到时可见
+  const int ss = sub_sampling_, ny = gridRows();
+  int n = 0;
+  for (int ky = 0; ky < ny; ++ky) {
+    const int y = 1 + ky * ss;
+    const int *b0 = bounds + 2 * (y - 1), *b1 = bounds + 2 * y, *b2 = bounds + 2 * (y + 1);
+    const int x_begin = 1 + std::max(b0[0], std::max(b1[0], b2[0]));
+    const int x_end = std::min(b0[1], std::min(b1[1], b2[1])) - 1;
+
+    // 换算到采样网格的列：x = 1 + kx * ss
+    const int kx_begin = (x_begin - 1 + ss - 1) / ss;
+    const int kx_end = x_end > 1 ? std::max(kx_begin, (x_end - 1 + ss - 1) / ss) : kx_begin;
+    cols[2 * ky] = kx_begin;
+    cols[2 * ky + 1] = kx_end;
+    for (int k_run = row_runs_[ky]; k_run < row_runs_[ky + 1]; ++k_run) {
+      int a, b;
+      ClipColumns(runs_[k_run].kx0, runs_[k_run].kx1, cols + 2 * ky, a, b);
+      n += b - a;
     }
   }
+  return n;
+}
+
+template<class M>
+void ChannelDataSampler<M>::HiddenHessians(const int *cols, Hessian *tile_hessians, int *tile_pixels) const {
+  const int ny = gridRows();
+
+  // 每行分块并行。块内隐藏的像素超过一半时，改为累加可见像素，从块的海塞矩阵中减去
+  cv::parallel_for_(cv::Range(0, tile_rows_), [&](const cv::Range &range) {
+    for (int ty = range.start; ty < range.end; ++ty) {
+      const int k_begin = row_runs_[std::min(ny, ty * tile_h_)], k_end = row_runs_[std::min(ny, (ty + 1) * tile_h_)];
+
+      // 1.每块隐藏的像素数
+      for (int tx = 0; tx < tile_cols_; ++tx)
+        tile_pixels[ty * tile_cols_ + tx] = 0;
+      for (int k_run = k_begin; k_run < k_end; ++k_run) {
+        const Run &run = runs_[k_run];
+        int a, b;
+        ClipColumns(run.kx0, run.kx1, cols + 2 * run.ky, a, b);
+        tile_pixels[run.tile] += (run.kx1 - run.kx0) - (b - a);
+      }
 
-  return ret;
+      // 2.累加隐藏或可见部分的雅可比矩阵行
+      for (int tx = 0; tx < tile_cols_; ++tx)
+        tile_hessians[ty * tile_cols_ + tx].setZero();
+      for (int k_run = k_begin; k_run < k_end; ++k_run) {
+        const Run &run = runs_[k_run];
+        int a, b;
+        ClipColumns(run.kx0, run.kx1, cols + 2 * run.ky, a, b);
+        Hessian &H = tile_hessians[run.tile];
+        if (2 * tile_pixels[run.tile] > tile_pixels_[run.tile]) {
+          const auto J = jacobian_.middleRows(8 * (run.index + a - run.kx0), 8 * (b - a));
+          H.noalias() += J.transpose() * J;
+        } else {
+          const auto J0 = jacobian_.middleRows(8 * run.index, 8 * (a - run.kx0));
+          const auto J1 = jacobian_.middleRows(8 * (run.index + b - run.kx0), 8 * (run.kx1 - b));
+          H.noalias() += J0.transpose() * J0;
+          H.noalias() += J1.transpose() * J1;
+        }
+      }
+      for (int tx = 0; tx < tile_cols_; ++tx) {
+        const int t = ty * tile_cols_ + tx;
+        if (2 * tile_pixels[t] > tile_pixels_[t])
+          tile_hessians[t] = tileHessian(t) - tile_hessians[t];
+      }
+    }
+  });
 }
 
-template<class Derived>
-static inline
-Eigen::Matrix<typename Derived::PlainObject::Scalar,
-  Derived::PlainObject::RowsAtCompileTime, Derived::PlainObject::ColsAtCompileTime>
-NormalizeHomography(const Eigen::MatrixBase<Derived> &x) {
-  static_assert(Derived::PlainObject::RowsAtCompileTime != Eigen::Dynamic &&
-                Derived::PlainObject::ColsAtCompileTime == 1,
-                "normHomog: input must be a vector of known dimension");
-
-  return x * (1.0f / x[Derived::PlainObject::RowsAtCompileTime - 1]);
+/**
+ * residuals of the LBP descriptors of part of a row of the warped image
+ *
+ * \param s_row the row of the warped image
+ * \param stride stride of the warped image
+ * \param x0 first column
+ * \param x1 end of the columns, excluded
+ * \param c0_ptr template pixels of the row, advanced past them
+ * \param r_ptr output residuals, advanced past them
+ */
+static inline void RowResiduals(const uint8_t *s_row, int stride, int x0, int x1, int step,
+                                const uint8_t *&c0_ptr, float *&r_ptr) {
+#pragma omp simd
+  for (int x = x0; x < x1; x += step) {
+    const uint8_t *p = s_row + x;
+    const uint8_t c = *c0_ptr++;
+    *r_ptr++ = static_cast<float>((*(p - stride - 1) >= *p) - ((c & (1 << 0)) >> 0));
+    *r_ptr++ = static_cast<float>((*(p - stride) >= *p) - ((c & (1 << 1)) >> 1));
+    *r_ptr++ = static_cast<float>((*(p - stride + 1) >= *p) - ((c & (1 << 2)) >> 2));
+    *r_ptr++ = static_cast<float>((*(p - 1) >= *p) - ((c & (1 << 3)) >> 3));
+    *r_ptr++ = static_cast<float>((*(p + 1) >= *p) - ((c & (1 << 4)) >> 4));
+    *r_ptr++ = static_cast<float>((*(p + stride - 1) >= *p) - ((c & (1 << 5)) >> 5));
+    *r_ptr++ = static_cast<float>((*(p + stride) >= *p) - ((c & (1 << 6)) >> 6));
+    *r_ptr++ = static_cast<float>((*(p + stride + 1) >= *p) - ((c & (1 << 7)) >> 7));
+  }
 }
 
+template<class M>
+void ChannelDataSampler<M>::ComputeResiduals(const cv::Mat &Iw, Residuals &residuals, const int *cols) const {
+  // 1.残差直接写入输出
+  assert(residuals.size() == 8 * pixels_.size());
+  const int ss = sub_sampling_;
+
+  // 2.逐段计算LBP描述子之间残差，不可见像素的残差为0
+  for (const Run &run : runs_) {
+    int a, b;
+    ClipColumns(run.kx0, run.kx1, cols ? cols + 2 * run.ky : nullptr, a, b);
+    float *r = residuals.data() + 8 * run.index;
+    std::fill(r, r + 8 * (a - run.kx0), 0.0f);
+    const uint8_t *c0_ptr = pixels_.data() + run.index + (a - run.kx0);
+    float *r_ptr = r + 8 * (a - run.kx0);
+    RowResiduals(Iw.ptr<const uint8_t>(1 + run.ky * ss), Iw.cols, 1 + a * ss, 1 + b * ss, ss, c0_ptr, r_ptr);
+    std::fill(r_ptr, r + 8 * (run.kx1 - run.kx0), 0.0f);
+  }
+}
+
+/**
+ * number of residuals accumulated before they are multiplied with the
+ * jacobian, small enough for the block to stay in the L1 cache
+ */
+static constexpr int RESIDUALS_PER_BLOCK = 512;
 
 template<class M>
-void ChannelDataSampler<M>::WarpImage(const cv::Mat &src, const Transform &T, const cv::Rect &roi,
-          cv::Mat &dst, int interp, float border) {
-  // 1.X和Y轴方向映射
-  cv::Mat x_map(roi.size(), CV_32FC1);
-  cv::Mat y_map(roi.size(), CV_32FC1);
+float ChannelDataSampler<M>::ComputeResidualsAndGradient(const cv::Mat &Iw, Residuals &residuals,
+                                                        Gradient &g, const int *cols) const {
+  assert(residuals.size() == 8 * pixels_.size());
+  g.setZero();
+  float sum_sq = 0.0f;
+
+  // 1.逐段计算残差，累计到一个块后立即与雅可比矩阵的对应行相乘，残差只读写一次内存
+  const int ss = sub_sampling_;
+  Eigen::Index begin = 0, end = 0;
+  auto flush = [&]() {
+    if (end > begin) {
+      const auto r = residuals.segment(begin, end - begin);
+      g.noalias() += jacobian_.middleRows(begin, end - begin).transpose() * r;
+      sum_sq += r.squaredNorm();
+    }
+    begin = end;
+  };
+  for (const Run &run : runs_) {
+    int a, b;
+    ClipColumns(run.kx0, run.kx1, cols ? cols + 2 * run.ky : nullptr, a, b);
+
+    // 2.不可见的像素残差为0，不参与块的乘法
+    if (a > run.kx0) {
+      flush();
+      end = 8 * (run.index + a - run.kx0);
+      std::fill(residuals.data() + begin, residuals.data() + end, 0.0f);
+      begin = end;
+    }
+    const uint8_t *c0_ptr = pixels_.data() + run.index + (a - run.kx0);
+    float *r_ptr = residuals.data() + end;
+    RowResiduals(Iw.ptr<const uint8_t>(1 + run.ky * ss), Iw.cols, 1 + a * ss, 1 + b * ss, ss, c0_ptr, r_ptr);
+    end = r_ptr - residuals.data();
+    if (b < run.kx1) {
+      flush();
+      end = 8 * (run.index + run.kx1 - run.kx0);
+      std::fill(residuals.data() + begin, residuals.data() + end, 0.0f);
+      begin = end;
+    }
 
-  assert(!x_map.empty() && !y_map.empty());
+    if (end - begin >= RESIDUALS_PER_BLOCK)
+      flush();
+  }
+  flush();
+
+  return sum_sq;
+}
+
+template<class M>
+void ChannelDataSampler<M>::ComputeTileResidualsAndGradients(const cv::Mat &Iw, Residuals &residuals,
+                                                             Gradient *g, float *sum_sq, const int *cols) const {
+  assert(residuals.size() == 8 * pixels_.size());
+  const int ss = sub_sampling_, ny = gridRows();
+
+  // 每行分块并行：逐段计算可见像素的残差并与雅可比矩阵的对应行相乘，累加到段所在的块
+  cv::parallel_for_(cv::Range(0, tile_rows_), [&](const cv::Range &range) {
+    for (int ty = range.start; ty < range.end; ++ty) {
+      for (int tx = 0; tx < tile_cols_; ++tx) {
+        g[ty * tile_cols_ + tx].setZero();
+        sum_sq[ty * tile_cols_ + tx] = 0.0f;
+      }
+
+      const int k_end = row_runs_[std::min(ny, (ty + 1) * tile_h_)];
+      for (int k_run = row_runs_[std::min(ny, ty * tile_h_)]; k_run < k_end; ++k_run) {
+        const Run &run = runs_[k_run];
+        int a, b;
+        ClipColumns(run.kx0, run.kx1, cols ? cols + 2 * run.ky : nullptr, a, b);
+        float *r = residuals.data() + 8 * run.index;
+        std::fill(r, r + 8 * (a - run.kx0), 0.0f);
+        const uint8_t *c0_ptr = pixels_.data() + run.index + (a - run.kx0);
+        float *r_ptr = r + 8 * (a - run.kx0);
+        RowResiduals(Iw.ptr<const uint8_t>(1 + run.ky * ss), Iw.cols, 1 + a * ss, 1 + b * ss, ss, c0_ptr, r_ptr);
+        std::fill(r_ptr, r + 8 * (run.kx1 - run.kx0), 0.0f);
+
+        const Eigen::Index begin = 8 * (run.index + a - run.kx0), len = 8 * (b - a);
+        const auto r_visible = residuals.segment(begin, len);
+        g[run.tile].noalias() += jacobian_.middleRows(begin, len).transpose() * r_visible;
+        sum_sq[run.tile] += r_visible.squaredNorm();
+      }
+    }
+  });
+}
+
+template<class M>
+bool ChannelDataSampler<M>::WarpImage(const cv::Mat &src, const Transform &T, const cv::Rect &roi,
+          cv::Mat &dst, int interp, float border, int *bounds, const cv::Rect *valid,
+          const cv::Point &origin) {
+  assert(src.type() == CV_8UC1);
+  assert(interp == cv::INTER_NEAREST || interp == cv::INTER_LINEAR);
+
+  // 1.输出图像大小不变时不重新分配
+  dst.create(roi.size(), CV_8UC1);
 
   using namespace Eigen;
 
-  // 2.获取单应矩阵作用后的ROI区域对应像素坐标
-  const int x_s = roi.x, y_s = roi.y;
+  const int cols = src.cols, rows = src.rows;
+  const auto src_stride = static_cast<int>(src.step[0]);
+  const float b = border;
+  const auto b_u8 = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, b + 0.5f)));
+  const Vector3f dp = T.col(0);
+  const auto ox = static_cast<float>(origin.x), oy = static_cast<float>(origin.y);
+  const cv::Rect v = valid ? *valid & cv::Rect(0, 0, cols, rows) : cv::Rect(0, 0, cols, rows);
+
+  // 2.逐行计算单应矩阵作用后的ROI坐标，并直接插值得到模板区域图像。
+  // 直线在单应变换下仍是直线，每行在有效区域内插值的像素是连续的一段，记录其首尾
+  bool all_inside = true;
   for (int y = 0; y < roi.height; ++y) {
-    auto *xm_ptr = x_map.ptr<float>(y);
-    auto *ym_ptr = y_map.ptr<float>(y);
+    auto *d_row = dst.ptr<uint8_t>(y);
+    Vector3f p = T * Vector3f(static_cast<float>(roi.x), static_cast<float>(y + roi.y), 1.0f);
+    int first = -1, last = -1;
+
+    for (int x = 0; x < roi.width; ++x, p += dp) {
+      // 将T作用在原始坐标上，并归一化得到当前帧中坐标，再减去src的起点。
+      // 减去整数起点不引入舍入误差，与在整幅图像上插值的结果一致
+      const float w_inv = 1.0f / p[2];
+      const float xf = p[0] * w_inv - ox, yf = p[1] * w_inv - oy;
+      if (!(xf > -1.0f && xf < static_cast<float>(cols) && yf > -1.0f && yf < static_cast<float>(rows))) {
+        d_row[x] = b_u8;
+        continue;
+      }
+
+      const int x0 = static_cast<int>(std::floor(xf)), y0 = static_cast<int>(std::floor(yf));
+      const bool inside = x0 >= 0 && y0 >= 0 && x0 + 1 < cols && y0 + 1 < rows;
+      if (x0 >= v.x && y0 >= v.y && x0 + 1 < v.x + v.width && y0 + 1 < v.y + v.height) {
+        first = first < 0 ? x : first;
+        last = x;
+      }
+      if (interp == cv::INTER_NEAREST) {
+        const int xn = std::min(cols - 1, x0 + (xf - x0 >= 0.5f)), yn = std::min(rows - 1, y0 + (yf - y0 >= 0.5f));
+        d_row[x] = (xn >= 0 && yn >= 0) ? src.ptr<const uint8_t>(yn)[xn] : b_u8;
+        continue;
+      }
 
-    int yy = y + y_s;
+      // 双线性插值，图像外的像素取border
+      const float ax = xf - static_cast<float>(x0), ay = yf - static_cast<float>(y0);
+      float v00, v01, v10, v11;
+      if (inside) {
+        const uint8_t *s = src.ptr<const uint8_t>(y0) + x0;
+        v00 = s[0];
+        v01 = s[1];
+        v10 = s[src_stride];
+        v11 = s[src_stride + 1];
+      } else {
+        auto at = [&](int xx, int yy) {
+          return (xx >= 0 && yy >= 0 && xx < cols && yy < rows) ?
+                 static_cast<float>(src.ptr<const uint8_t>(yy)[xx]) : b;
+        };
+        v00 = at(x0, y0);
+        v01 = at(x0 + 1, y0);
+        v10 = at(x0, y0 + 1);
+        v11 = at(x0 + 1, y0 + 1);
+      }
 
-    for (int x = 0; x < roi.width; ++x) {
-      // 将T作用在原始坐标上，并归一化得到当前帧中坐标
-      const Vector3f pw = NormalizeHomography(T * Vector3f(static_cast<float>(x + x_s), static_cast<float>(yy), 1.0f));
-      xm_ptr[x] = pw[0];
-      ym_ptr[x] = pw[1];
+      const float v = (1.0f - ay) * ((1.0f - ax) * v00 + ax * v01) + ay * ((1.0f - ax) * v10 + ax * v11);
+      d_row[x] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, v + 0.5f)));
     }
-  }
 
-  // 3.获取单应矩阵作用后的模板区域图像
-  cv::remap(src, dst, x_map, y_map, interp, cv::BORDER_CONSTANT, cv::Scalar(border));
+    all_inside = all_inside && first == 0 && last == roi.width - 1;
+    if (bounds) {
+      bounds[2 * y] = first < 0 ? 0 : first;
+      bounds[2 * y + 1] = first < 0 ? 0 : last + 1;
+    }
+  }
+  return all_inside;
 }
 
 template<class M>
@@ -191,21 +625,27 @@ void ChannelDataSampler<M>::getNormedCoordinate(const cv::Rect & /*roi*/, Transf
   T_inv.setIdentity();
 }
 
+/**
+ * mean distance to the center of the points of a rectangle with half sides a
+ * and b
+ */
+static inline float MeanDistanceToCenter(float a, float b) {
+  if (a <= 0.0f || b <= 0.0f)
+    return 0.5f * std::max(a, b);
+  const float d = std::sqrt(a * a + b * b);
+  return (d + a * a / (2.0f * b) * std::log((b + d) / a) + b * b / (2.0f * a) * std::log((a + d) / b)) / 3.0f;
+}
+
 template<>
 void ChannelDataSampler<Homography>::getNormedCoordinate(const cv::Rect &roi, Transform &T, Transform &T_inv) const {
-  Vector2f c(0, 0);
-
-  int n_valid = 0;
-  for (int y = 1; y < roi.height - 1; y += sub_sampling_)
-    for (int x = 1; x < roi.width - 1; x += sub_sampling_, ++n_valid)
-      c += Vector2f(x + roi.x, y + roi.y);
-  c /= n_valid;
-
-  float m = 0.0f;
-  for (int y = 1; y < roi.height - 1; y += sub_sampling_)
-    for (int x = 1; x < roi.width - 1; x += sub_sampling_)
-      m += (Vector2f(x + roi.x, y + roi.y) - c).norm();
-  m /= n_valid;
+  // 1.采样点的中心：采样网格的中心
+  const int ss = sub_sampling_;
+  const int nx = std::max(1, (roi.width - 2 + ss - 1) / ss), ny = std::max(1, (roi.height - 2 + ss - 1) / ss);
+  const Vector2f c(static_cast<float>(roi.x) + 1.0f + 0.5f * static_cast<float>(ss * (nx - 1)),
+                   static_cast<float>(roi.y) + 1.0f + 0.5f * static_cast<float>(ss * (ny - 1)));
+
+  // 2.采样点到中心的平均距离：每个采样点代表ss x ss的区域，取矩形的解析解
+  const float m = MeanDistanceToCenter(0.5f * static_cast<float>(ss * nx), 0.5f * static_cast<float>(ss * ny));
 
   float s = sqrt(2.0f) / std::max(m, 1e-6f);
 
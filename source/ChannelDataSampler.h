@@ -9,6 +9,7 @@
 
 #include "API.h"
 #include "Types.h"
+#include "Arena.h"
 #include <opencv2/opencv.hpp>
 
 NAMESPACE_BEGIN
@@ -22,6 +23,7 @@ public:
   typedef typename ChannelDataTraits<Derived>::MotionModelType MotionModelType;
   typedef typename ChannelDataTraits<Derived>::Pixels Pixels;
   typedef typename ChannelDataTraits<Derived>::Residuals Residuals;
+  typedef typename ChannelDataTraits<Derived>::JacobianMap JacobianMap;
   typedef typename MotionModelType::WarpJacobian WarpJacobian;
   typedef typename MotionModelType::JacobianMatrix JacobianMatrix;
   typedef typename MotionModelType::Transform Transform;
@@ -47,14 +49,32 @@ public:
    *
    * \param warped_image the warped image
    * \param residuals  output residuals
+   * \param cols visible columns of the template, nullptr if all of it is
+   * visible
    */
-  inline void ComputeResiduals(const cv::Mat &warped_image, Residuals &residuals) const {
-    return derived()->ComputeResiduals(warped_image, residuals);
+  inline void ComputeResiduals(const cv::Mat &warped_image, Residuals &residuals,
+                               const int *cols = nullptr) const {
+    return derived()->ComputeResiduals(warped_image, residuals, cols);
+  }
+
+  /**
+   * computes the residuals and the cost function gradient
+   *
+   * \param warped_image the warped image
+   * \param residuals output residuals
+   * \param g output gradient, J^T * residuals
+   * \param cols visible columns of the template, nullptr if all of it is
+   * visible
+   * \return the sum of squared residuals
+   */
+  inline float ComputeResidualsAndGradient(const cv::Mat &warped_image, Residuals &residuals, Gradient &g,
+                                           const int *cols = nullptr) const {
+    return derived()->ComputeResidualsAndGradient(warped_image, residuals, g, cols);
   }
 
   template<class ... Args>
   inline
-  void warpImage(const cv::Mat &src, const Transform &T, const cv::Rect &bbox,
+  bool warpImage(const cv::Mat &src, const Transform &T, const cv::Rect &bbox,
                  cv::Mat &dst, Args &...args) const {
     return derived()->WarpImage(src, T, bbox, dst, args...);
   }
@@ -63,7 +83,7 @@ public:
 
   inline const Hessian &hessian() const { return derived()->hessian(); }
 
-  inline const JacobianMatrix &jacobian() const { return derived()->jacobian(); }
+  inline const JacobianMap &jacobian() const { return derived()->jacobian(); }
 
   inline void getNormedCoordinate(const cv::Rect &roi,
                                   Transform &T, Transform &T_inv) const {
@@ -82,8 +102,9 @@ class ChannelDataSampler;
 template<class M>
 struct ChannelDataTraits<ChannelDataSampler<M> > {
   typedef M MotionModelType;
-  typedef Vector_<uint8_t> Pixels;
-  typedef Vector_<float> Residuals;
+  typedef Eigen::Map<Vector_<uint8_t>> Pixels;
+  typedef Eigen::Map<Vector_<float>, Eigen::Aligned> Residuals;
+  typedef Eigen::Map<typename M::JacobianMatrix, Eigen::Aligned> JacobianMap;
 };
 
 template<class M>
@@ -95,6 +116,7 @@ public:
   typedef typename Base::MotionModelType MotionModelType;
   typedef typename Base::Pixels Pixels;
   typedef typename Base::Residuals Residuals;
+  typedef typename Base::JacobianMap JacobianMap;
   typedef typename Base::WarpJacobian WarpJacobian;
   typedef typename Base::JacobianMatrix JacobianMatrix;
   typedef typename Base::Hessian Hessian;
@@ -107,32 +129,207 @@ public:
    * value of 2 means decimate by half, and so on
    */
   explicit inline ChannelDataSampler(size_t s = 1)
-    : Base(), sub_sampling_(s) {}
+    : Base(), jacobian_(nullptr, 0, M::DOF), pixels_(nullptr, 0), sub_sampling_(s) {}
+
+  /**
+   * sets the template data. The pixels and jacobians are stored in the arena,
+   * which must have BufferSize(roi, mask) bytes remaining
+   *
+   * \param mask CV_8UC1 of the size of roi, only the pixels where it is non
+   * zero are part of the template and stored. Empty for the whole roi
+   */
+  void set(const cv::Mat &, const cv::Rect &roi, Arena &arena, float s = 1,
+           float c1 = 0, float c2 = 0, const cv::Mat &mask = cv::Mat());
+
+  /**
+   * shares the template data of other without copying it: the pixels and
+   * jacobians stay in the arena of other, which must outlive this sampler. The
+   * other members are copied
+   */
+  void shareFrom(const ChannelDataSampler &other);
+
+  /**
+   * re-samples the template pixels inside region and updates their jacobians.
+   * The hessian is updated with the change of the jacobian rows instead of
+   * being recomputed
+   *
+   * \param src the new template image, or the part of it around region
+   * \param origin location of src in the template image
+   * \param region region of the template image to update. src must cover it
+   * with 2 more pixels on each side
+   * \return the number of updated template pixels
+   */
+  int update(const cv::Mat &src, const cv::Point &origin, const cv::Rect &region);
+
+  /**
+   * splits the template into square tiles, each with its own hessian, see
+   * ComputeTileResidualsAndGradients. Takes effect at the next call to set
+   *
+   * \param tile_size side of the tiles in template pixels, <= 0 for a single
+   * tile
+   */
+  inline void setTileSize(int tile_size) { tile_size_ = tile_size; }
+
+  inline int numTiles() const { return tile_cols_ * tile_rows_; }
+
+  /**
+   * \return the number of rows of the sampling grid
+   */
+  inline int gridRows() const { return static_cast<int>(row_runs_.size()) - 1; }
+
+  /**
+   * \return the part of the hessian from the pixels of tile t
+   */
+  inline const Hessian &tileHessian(int t) const { return tile_hessians_[t]; }
+
+  /**
+   * \return the number of template pixels in tile t
+   */
+  inline int tilePixels(int t) const { return tile_pixels_[t]; }
+
+  /**
+   * \return the number of template pixels sampled in roi, see set for the
+   * mask
+   */
+  int NumPixels(const cv::Rect &roi, const cv::Mat &mask = cv::Mat()) const;
+
+  /**
+   * \return bytes of the arena used by set for the given roi and mask
+   */
+  size_t BufferSize(const cv::Rect &roi, const cv::Mat &mask = cv::Mat()) const;
 
-  void set(const cv::Mat &, const cv::Rect &roi, float s = 1,
-           float c1 = 0, float c2 = 0);
+  /**
+   * finds the template pixels whose LBP neighborhood was warped from inside
+   * the image, see WarpImage
+   *
+   * \param bounds columns of the warped image inside the image, output of
+   * WarpImage
+   * \param cols output range [begin, end) of visible columns of each row of
+   * the sampling grid, 2 * gridRows() of them
+   * \return the number of visible template pixels
+   */
+  int VisibleColumns(const int *bounds, int *cols) const;
+
+  /**
+   * the part of the hessian of each tile from the template pixels that are
+   * not visible
+   *
+   * \param cols visible columns, output of VisibleColumns
+   * \param tile_hessians output hessian of the hidden pixels of each tile
+   * \param tile_pixels output number of hidden pixels of each tile
+   */
+  void HiddenHessians(const int *cols, Hessian *tile_hessians, int *tile_pixels) const;
 
-  void ComputeResiduals(const cv::Mat &Iw, Residuals &residuals) const;
+  /**
+   * \param residuals output residuals, 8 per template pixel. Must be of that
+   * size already
+   * \param cols visible columns, output of VisibleColumns. The residuals of
+   * the other template pixels are zero and not computed. nullptr if all the
+   * template is visible
+   */
+  void ComputeResiduals(const cv::Mat &Iw, Residuals &residuals, const int *cols = nullptr) const;
 
-  float DoLinearize(const cv::Mat &Iw, Gradient &) const;
+  /**
+   * computes the residuals and the gradient J^T * residuals in a single pass,
+   * block by block so that each block of residuals is multiplied with the
+   * jacobian while it is still in cache
+   *
+   * \param residuals output residuals, see ComputeResiduals
+   * \param g output gradient
+   * \param cols visible columns, see ComputeResiduals
+   * \return the sum of squared residuals
+   */
+  float ComputeResidualsAndGradient(const cv::Mat &Iw, Residuals &residuals, Gradient &g,
+                                    const int *cols = nullptr) const;
 
-  void WarpImage(const cv::Mat &src, const Transform &T, const cv::Rect &roi,
-                 cv::Mat &dst, int interp = cv::INTER_LINEAR, float border = 0.0f);
+  /**
+   * same as ComputeResidualsAndGradient, per tile. The rows of tiles are
+   * processed in parallel
+   *
+   * \param residuals output residuals, see ComputeResiduals
+   * \param g output gradient of each tile, numTiles() of them
+   * \param sum_sq output sum of squared residuals of each tile
+   * \param cols visible columns, see ComputeResiduals
+   */
+  void ComputeTileResidualsAndGradients(const cv::Mat &Iw, Residuals &residuals, Gradient *g, float *sum_sq,
+                                        const int *cols = nullptr) const;
+
+  /**
+   * warps the roi of the template from src. Pixels warped from outside src
+   * are set to border
+   *
+   * \param interp cv::INTER_NEAREST or cv::INTER_LINEAR, the only
+   * interpolations supported
+   * \param bounds if not nullptr, output range [begin, end) of the columns of
+   * each row of dst that were interpolated from inside the valid region,
+   * 2 * roi.height of them
+   * \param valid the region of src with valid pixels, nullptr for all of it
+   * \param origin position of src in the image T warps to, src being a crop of
+   * it. The warped coordinates are computed in that image, so that a crop
+   * interpolates the same values as the whole image
+   * \return true if all of dst was interpolated from inside the valid region
+   */
+  bool WarpImage(const cv::Mat &src, const Transform &T, const cv::Rect &roi,
+                 cv::Mat &dst, int interp = cv::INTER_LINEAR, float border = 0.0f, int *bounds = nullptr,
+                 const cv::Rect *valid = nullptr, const cv::Point &origin = cv::Point());
 
   inline const Pixels &pixels() const { return pixels_; }
 
   inline const Hessian &hessian() const { return hessian_; }
 
-  inline const JacobianMatrix &jacobian() const { return jacobian_; }
+  inline const JacobianMap &jacobian() const { return jacobian_; }
 
   void getNormedCoordinate(const cv::Rect &, Transform &, Transform &) const;
 
 protected:
-  JacobianMatrix jacobian_;
-  Pixels pixels_;
+  /**
+   * consecutive template pixels of a row of the sampling grid, in one tile.
+   * The pixels, jacobians and residuals of the template are stored run after
+   * run
+   */
+  struct Run {
+    int ky;        //< row of the sampling grid
+    int kx0, kx1;  //< columns [kx0, kx1) of the sampling grid
+    int index;     //< index of the first pixel of the run in pixels_
+    int tile;
+  };
+
+  /**
+   * sets the tiles over the nx * ny sampling grid
+   */
+  void SetTileLayout(int nx, int ny);
+
+  /**
+   * sets the runs of the template pixels of the nx * ny sampling grid that
+   * are inside mask, and the number of pixels of each tile
+   *
+   * \return the number of template pixels
+   */
+  int SetRuns(int nx, int ny, const cv::Mat &mask);
+
+  /**
+   * recomputes the hessians of the tiles that intersect the range
+   * [kx0, kx1] x [ky0, ky1] of the sampling grid
+   */
+  void ComputeTileHessians(int kx0, int kx1, int ky0, int ky1);
+
+protected:
+  JacobianMap jacobian_;      //< view of the jacobians in the arena
+  Pixels pixels_;             //< view of the template pixels in the arena
   Hessian hessian_;
   int sub_sampling_;
   int roi_stride_;
+  cv::Rect roi_;              //< the template location given to set
+  float scale_ = 1.0f;        //< normalization given to set
+  float c1_ = 0.0f, c2_ = 0.0f;
+  size_t num_updated_ = 0;    //< pixels updated since the hessian was last computed in full
+  int tile_size_ = 0;         //< side of the tiles in template pixels, <= 0 for one tile
+  int tile_w_ = 1, tile_h_ = 1;          //< size of the tiles on the sampling grid
+  int tile_cols_ = 1, tile_rows_ = 1;
+  typename EigenStdVector<Hessian>::type tile_hessians_;
+  std::vector<int> tile_pixels_;
+  std::vector<Run> runs_;
+  std::vector<int> row_runs_;  //< first run of each row of the sampling grid, followed by the number of runs
 };
 
 bool TestConverged(float dp_norm, float p_norm, float x_tol, float g_norm,
@@ -0,0 +1,114 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/28 14:21
+ * @Description: Filter
+ * @FilePath: Bitplanes/source/Filter.cc
+ */
+#include "Filter.h"
+#include <cassert>
+#include <cstdint>
+
+NAMESPACE_BEGIN
+namespace imgproc {
+/**
+ * index of i reflected inside [0, n) without repeating the border pixel, same
+ * as cv::BORDER_REFLECT_101
+ */
+static inline int Reflect101(int i, int n) {
+  if (n == 1)
+    return 0;
+  while (i < 0 || i >= n)
+    i = i < 0 ? -i : 2 * n - 2 - i;
+  return i;
+}
+
+GaussianFilter::GaussianFilter(float sigma) : radius_(0) {
+  if (sigma <= 0.0f)
+    return;
+
+  // 与cv::GaussianBlur对8位图像的核大小一致
+  radius_ = cvRound(sigma * 3 * 2 + 1) / 2;
+  kernel_ = cv::getGaussianKernel(2 * radius_ + 1, sigma, CV_32F);
+  filter_ = cv::hal::SepFilter2D::create(CV_8U, CV_8U, CV_32F, kernel_.data, kernel_.rows, kernel_.data, kernel_.rows,
+                                         radius_, radius_, 0.0, cv::BORDER_REFLECT_101);
+}
+
+GaussianFilter::GaussianFilter(const GaussianFilter &other) : GaussianFilter() {
+  *this = other;
+}
+
+GaussianFilter &GaussianFilter::operator=(const GaussianFilter &other) {
+  if (this == &other)
+    return *this;
+
+  // OpenCV的滤波器保存了行缓存，不能与other共用，按相同的核重新创建
+  kernel_ = other.kernel_.clone();
+  radius_ = other.radius_;
+  filter_.reset();
+  if (radius_ > 0) {
+    filter_ = cv::hal::SepFilter2D::create(CV_8U, CV_8U, CV_32F, kernel_.data, kernel_.rows, kernel_.data, kernel_.rows,
+                                           radius_, radius_, 0.0, cv::BORDER_REFLECT_101);
+  }
+  reserve(other.reserved_);
+  return *this;
+}
+
+void GaussianFilter::reserve(const cv::Size &size) {
+  reserved_ = size;
+  if (!filter_ || size.area() <= 0)
+    return;
+
+  // 滤波器的行缓存随ROI宽度增长，先滤波一次这个大小的图像
+  cv::Mat src = cv::Mat::zeros(size, CV_8UC1), dst;
+  apply(src, cv::Rect(0, 0, size.width, size.height), dst);
+}
+
+void GaussianFilter::apply(const cv::Mat &src, const cv::Rect &roi, cv::Mat &dst) {
+  assert(src.type() == CV_8UC1);
+  assert((roi & cv::Rect(0, 0, src.cols, src.rows)) == roi);
+
+  dst.create(roi.size(), CV_8UC1);
+  if (radius_ == 0) {
+    src(roi).copyTo(dst);
+    return;
+  }
+
+  // ROI外的src像素作为滤波边界，src边界处反射
+  assert(dst.data != src.data);
+  auto *data = const_cast<uchar *>(src.ptr<uchar>(roi.y) + roi.x);
+  filter_->apply(data, src.step[0], dst.data, dst.step[0], roi.width, roi.height, src.cols, src.rows, roi.x, roi.y);
+}
+
+void PyrDown(const cv::Mat &src, cv::Mat &dst) {
+  assert(src.type() == CV_8UC1 && !src.empty());
+
+  const int w = src.cols, h = src.rows;
+  dst.create((h + 1) / 2, (w + 1) / 2, CV_8UC1);
+  assert(dst.data != src.data);
+
+  for (int y = 0; y < dst.rows; ++y) {
+    // 1.竖直方向[1 4 6 4 1]滤波用到的5行，图像边界处反射
+    const auto *s0 = src.ptr<const uint8_t>(Reflect101(2 * y - 2, h));
+    const auto *s1 = src.ptr<const uint8_t>(Reflect101(2 * y - 1, h));
+    const auto *s2 = src.ptr<const uint8_t>(2 * y);
+    const auto *s3 = src.ptr<const uint8_t>(Reflect101(2 * y + 1, h));
+    const auto *s4 = src.ptr<const uint8_t>(Reflect101(2 * y + 2, h));
+    auto v = [&](int x) { return s0[x] + 4 * (s1[x] + s3[x]) + 6 * s2[x] + s4[x]; };
+
+    // 2.水平方向[1 4 6 4 1]滤波并隔点采样，权重和为256，与cv::pyrDown的整数运算相同。
+    // 相邻输出共用3列的竖直滤波结果，不需要行缓存
+    auto *d = dst.ptr<uint8_t>(y);
+    int v0 = v(Reflect101(-2, w)), v1 = v(Reflect101(-1, w)), v2 = v(0);
+    for (int x = 0; x < dst.cols; ++x) {
+      const int v3 = v(Reflect101(2 * x + 1, w)), v4 = v(Reflect101(2 * x + 2, w));
+      d[x] = static_cast<uint8_t>((v0 + 4 * (v1 + v3) + 6 * v2 + v4 + 128) >> 8);
+      v0 = v2;
+      v1 = v3;
+      v2 = v4;
+    }
+  }
+}
+
+} // namespace imgproc
+NAMESPACE_END
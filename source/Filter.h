@@ -0,0 +1,77 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/28 14:05
+ * @Description: Filter
+ * @FilePath: Bitplanes/source/Filter.h
+ */
+#pragma once
+
+#include "API.h"
+#include "Types.h"
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgproc/hal/hal.hpp>
+
+NAMESPACE_BEGIN
+namespace imgproc {
+/**
+ * Separable Gaussian filter for 8-bit single channel images. It keeps the
+ * OpenCV filter and its buffers between calls, so that filtering regions up
+ * to the reserved size does not allocate
+ */
+class GaussianFilter {
+public:
+  /**
+   * \param sigma std. deviation of the Gaussian, <= 0 means no smoothing
+   */
+  explicit GaussianFilter(float sigma = 0.0f);
+
+  /**
+   * the copy has its own OpenCV filter with the same kernel and reserved size
+   */
+  GaussianFilter(const GaussianFilter &other);
+
+  GaussianFilter &operator=(const GaussianFilter &other);
+
+  /**
+   * reserves the buffers to filter regions up to the given size
+   */
+  void reserve(const cv::Size &size);
+
+  /**
+   * smooths the roi of src into dst. The pixels of src around the roi are used
+   * for the border, the border is reflected at the bounds of src
+   *
+   * \param src the source image (CV_8UC1)
+   * \param roi region of src to smooth
+   * \param dst destination image, re-allocated only if its size is not the
+   * size of roi. It must not share memory with src
+   */
+  void apply(const cv::Mat &src, const cv::Rect &roi, cv::Mat &dst);
+
+  /**
+   * \return the radius of the kernel
+   */
+  inline int radius() const { return radius_; }
+
+private:
+  cv::Mat kernel_;                          //< 2 * radius_ + 1 weights (CV_32F)
+  int radius_;
+  cv::Ptr<cv::hal::SepFilter2D> filter_;    //< separable filter of OpenCV, with its row buffers
+  cv::Size reserved_;                       //< size given to reserve
+};
+
+/**
+ * Gaussian pyramid down-sampling, the same result as cv::pyrDown with the
+ * default border. No pixels are read outside of src, and no scratch memory is
+ * used: with a dst of the output size already, e.g. a level reserved at
+ * setTemplate, it does not allocate
+ *
+ * \param src the source image (CV_8UC1)
+ * \param dst the destination image, re-allocated only if its size is not
+ * ((src.cols + 1) / 2, (src.rows + 1) / 2)
+ */
+void PyrDown(const cv::Mat &src, cv::Mat &dst);
+
+} // namespace imgproc
+NAMESPACE_END
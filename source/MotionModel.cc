@@ -7,10 +7,51 @@
  */
 #include "MotionModel.h"
 
-#include <unsupported/Eigen/MatrixFunctions> // for exp and log
+#include <unsupported/Eigen/MatrixFunctions> // for exp
 #include <Eigen/Cholesky>
+#include <Eigen/LU>
+#include <cmath>
 
 NAMESPACE_BEGIN
+/**
+ * principal logarithm of a 3x3 matrix by inverse scaling and squaring.
+ *
+ * Only uses fixed size temporaries, Eigen's MatrixBase::log() allocates on the
+ * heap when it splits the eigenvalues in clusters
+ */
+static Eigen::Matrix3d Log(const Eigen::Matrix3d &H) {
+  const Eigen::Matrix3d I = Eigen::Matrix3d::Identity();
+
+  // 1.反复开平方根(Denman-Beavers迭代)，直到接近单位阵
+  Eigen::Matrix3d A = H;
+  int k = 0;
+  while ((A - I).norm() > 0.25 && k < 32) {
+    Eigen::Matrix3d Y = A, Z = I;
+    for (int i = 0; i < 32; ++i) {
+      const Eigen::Matrix3d Y_inv = Y.inverse();
+      const Eigen::Matrix3d Y_next = 0.5 * (Y + Z.inverse());
+      Z = 0.5 * (Z + Y_inv);
+      const double delta = (Y_next - Y).norm();
+      Y = Y_next;
+      if (!(delta > 1e-12 * Y.norm()))
+        break;
+    }
+    A = Y;
+    ++k;
+  }
+
+  // 2.log(I + X)的级数展开，|X| <= 0.25
+  const Eigen::Matrix3d X = A - I;
+  Eigen::Matrix3d L = Eigen::Matrix3d::Zero(), P = I;
+  for (int n = 1; n <= 30; ++n) {
+    P = P * X;
+    L += ((n & 1) ? 1.0 : -1.0) / n * P;
+  }
+
+  // 3.log(H) = 2^k * log(H^(1/2^k))
+  return std::ldexp(1.0, k) * L;
+}
+
 auto Homography::Scale(const Transform &T, float scale) -> Transform {
   Transform S(Transform::Identity()), S_i(Transform::Identity());
   S(0, 0) = scale;
@@ -21,7 +62,7 @@ auto Homography::Scale(const Transform &T, float scale) -> Transform {
 }
 
 auto Homography::MatrixToParams(const Transform &H) -> ParameterVector {
-  Transform L = H.log();
+  const Transform L = Log(H.cast<double>()).cast<float>();
   ParameterVector p;
   p[0] = L(0, 2);
   p[1] = L(1, 2);
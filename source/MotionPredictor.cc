@@ -0,0 +1,117 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/27 10:31
+ * @Description: Motion Predictor
+ * @FilePath: Bitplanes/source/MotionPredictor.cc
+ */
+#include "MotionPredictor.h"
+
+#include <Eigen/LU>
+#include <cmath>
+
+NAMESPACE_BEGIN
+template<class M>
+void ConstantVelocityPredictor<M>::reset() {
+  T_.setIdentity();
+  v_.setZero();
+  t_ = 0.0;
+  num_poses_ = 0;
+}
+
+template<class M>
+bool ConstantVelocityPredictor<M>::MeasureVelocity(const Transform &T, double t, ParameterVector &v) const {
+  const double dt = t - t_;
+  if (num_poses_ == 0 || !(dt > 0.0))
+    return false;
+
+  // 1.相对运动，并归一化到行列式为1
+  Transform D = T * T_.inverse();
+  const float det = D.determinant();
+  if (!(det > 0.0f))
+    return false;
+  D /= std::cbrt(det);
+
+  // 2.单位时间内sl(3)参数变化
+  v = MotionModelType::MatrixToParams(D) / static_cast<float>(dt);
+  return v.allFinite();
+}
+
+template<class M>
+void ConstantVelocityPredictor<M>::update(const Transform &T, double t) {
+  ParameterVector v;
+  if (MeasureVelocity(T, t, v))
+    v_ = v;
+  else if (num_poses_ != 0 && t != t_)
+    v_.setZero();
+
+  T_ = T;
+  t_ = t;
+  ++num_poses_;
+}
+
+template<class M>
+auto ConstantVelocityPredictor<M>::predict(double t) const -> Transform {
+  if (num_poses_ < 2)
+    return T_;
+  const auto dt = static_cast<float>(t - t_);
+  return MotionModelType::ParamsToMatrix(dt * v_) * T_;
+}
+
+template<class M>
+void KalmanPredictor<M>::reset() {
+  Base::reset();
+  P_.setConstant(r_);
+}
+
+template<class M>
+void KalmanPredictor<M>::update(const Transform &T, double t) {
+  ParameterVector z;
+  if (this->MeasureVelocity(T, t, z)) {
+    if (this->num_poses_ < 2) {
+      // 1.第一次测量直接作为速度初值
+      this->v_ = z;
+      P_.setConstant(r_);
+    } else {
+      // 2.预测：速度为随机游走
+      P_.array() += q_ * static_cast<float>(t - this->t_);
+      // 3.更新：逐维标量卡尔曼增益
+      const ParameterVector K = P_.array() / (P_.array() + r_);
+      this->v_ += K.cwiseProduct(z - this->v_);
+      P_ = (1.0f - K.array()) * P_.array();
+    }
+  } else if (this->num_poses_ != 0 && t != this->t_) {
+    this->v_.setZero();
+    P_.setConstant(r_);
+  }
+
+  this->T_ = T;
+  this->t_ = t;
+  ++this->num_poses_;
+}
+
+template<class M>
+std::shared_ptr<MotionPredictor<M>> MakeMotionPredictor(Parameters::MotionPredictorType type) {
+  switch (type) {
+    case Parameters::MotionPredictorType::ConstantVelocity:
+      return std::allocate_shared<ConstantVelocityPredictor<M>>(
+        Eigen::aligned_allocator<ConstantVelocityPredictor<M>>());
+    case Parameters::MotionPredictorType::Kalman:
+      return std::allocate_shared<KalmanPredictor<M>>(
+        Eigen::aligned_allocator<KalmanPredictor<M>>());
+    case Parameters::MotionPredictorType::None:
+      break;
+  }
+  return nullptr;
+}
+
+template
+class ConstantVelocityPredictor<Homography>;
+
+template
+class KalmanPredictor<Homography>;
+
+template
+std::shared_ptr<MotionPredictor<Homography>> MakeMotionPredictor<Homography>(Parameters::MotionPredictorType);
+
+NAMESPACE_END
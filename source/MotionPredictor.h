@@ -0,0 +1,125 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/27 10:12
+ * @Description: Motion Predictor
+ * @FilePath: Bitplanes/source/MotionPredictor.h
+ */
+#pragma once
+
+#include "API.h"
+#include "Types.h"
+#include "Parameters.h"
+#include "MotionModel.h"
+
+#include <memory>
+
+NAMESPACE_BEGIN
+/**
+ * Predicts the pose of the next frame from the poses estimated for the
+ * previous frames. Used to initialize PyramidTracker
+ */
+template<class M>
+class MotionPredictor {
+public:
+  typedef MotionModel<M> MotionModelType;
+  typedef typename MotionModelType::Transform Transform;
+  typedef typename MotionModelType::ParameterVector ParameterVector;
+
+public:
+  virtual ~MotionPredictor() = default;
+
+  /**
+   * clears the history. The next prediction is the identity
+   */
+  virtual void reset() = 0;
+
+  /**
+   * adds the pose estimated for a frame
+   *
+   * \param T the estimated pose
+   * \param t timestamp of the frame
+   */
+  virtual void update(const Transform &T, double t) = 0;
+
+  /**
+   * \return the predicted pose for the frame at time t
+   */
+  virtual Transform predict(double t) const = 0;
+
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+};
+
+/**
+ * Extrapolates the last pose with the velocity of the last two poses. The
+ * velocity is expressed on the sl(3) parameters of the relative motion
+ */
+template<class M>
+class ConstantVelocityPredictor : public MotionPredictor<M> {
+public:
+  typedef MotionPredictor<M> Base;
+  typedef typename Base::MotionModelType MotionModelType;
+  typedef typename Base::Transform Transform;
+  typedef typename Base::ParameterVector ParameterVector;
+
+public:
+  ConstantVelocityPredictor() { reset(); }
+
+  void reset() override;
+
+  void update(const Transform &T, double t) override;
+
+  Transform predict(double t) const override;
+
+protected:
+  /**
+   * computes the velocity (parameters per time unit) of the relative motion
+   * between the last pose and T
+   *
+   * \return false if the velocity could not be computed
+   */
+  bool MeasureVelocity(const Transform &T, double t, ParameterVector &v) const;
+
+protected:
+  Transform T_;              //< last pose
+  ParameterVector v_;        //< velocity in sl(3) per time unit
+  double t_;                 //< timestamp of the last pose
+  int num_poses_;            //< number of poses added since the last reset
+};
+
+/**
+ * Constant velocity model where the velocity is filtered with a diagonal
+ * Kalman filter (random walk on the sl(3) velocity)
+ */
+template<class M>
+class KalmanPredictor : public ConstantVelocityPredictor<M> {
+public:
+  typedef ConstantVelocityPredictor<M> Base;
+  typedef typename Base::Transform Transform;
+  typedef typename Base::ParameterVector ParameterVector;
+
+public:
+  /**
+   * \param process_noise variance of the velocity change per time unit
+   * \param measurement_noise variance of the measured velocity
+   */
+  explicit KalmanPredictor(float process_noise = 1e-2f, float measurement_noise = 1e-2f)
+    : Base(), q_(process_noise), r_(measurement_noise) { reset(); }
+
+  void reset() override;
+
+  void update(const Transform &T, double t) override;
+
+protected:
+  ParameterVector P_;        //< variance of the velocity estimate
+  float q_, r_;
+};
+
+/**
+ * creates the predictor for the given type, returns nullptr for None
+ */
+template<class M>
+std::shared_ptr<MotionPredictor<M>> MakeMotionPredictor(Parameters::MotionPredictorType type);
+
+NAMESPACE_END
@@ -0,0 +1,106 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/01 11:20
+ * @Description: MultiTargetTracker
+ * @FilePath: Bitplanes/source/MultiTargetTracker.cc
+ */
+#include "MultiTargetTracker.h"
+#include "MotionModel.h"
+
+#include <algorithm>
+
+NAMESPACE_BEGIN
+template<class M>
+MultiTargetTracker<M>::MultiTargetTracker(Parameters p, int num_threads)
+  : params_(p), pool_(num_threads) {}
+
+template<class M>
+typename MultiTargetTracker<M>::TargetId MultiTargetTracker<M>::addTarget(const cv::Mat &I, const cv::Rect &bbox) {
+  Target target;
+  target.id = next_id_++;
+  target.tracker.reset(new TrackerType(params_));
+  target.tracker->setTemplate(I, bbox);
+  target.area = bbox.area();
+  targets_.push_back(std::move(target));
+
+  results_.resize(targets_.size());
+  UpdateOrder();
+  return targets_.back().id;
+}
+
+template<class M>
+bool MultiTargetTracker<M>::removeTarget(TargetId id) {
+  auto it = std::find_if(targets_.begin(), targets_.end(), [id](const Target &t) { return t.id == id; });
+  if (it == targets_.end())
+    return false;
+
+  targets_.erase(it);
+  results_.resize(targets_.size());
+  UpdateOrder();
+  return true;
+}
+
+template<class M>
+typename MultiTargetTracker<M>::TrackerType *MultiTargetTracker<M>::tracker(TargetId id) {
+  for (auto &t : targets_) {
+    if (t.id == id)
+      return t.tracker.get();
+  }
+  return nullptr;
+}
+
+template<class M>
+const std::vector<typename MultiTargetTracker<M>::TargetResult> &
+MultiTargetTracker<M>::Track(const cv::Mat &I, double timestamp) {
+  time_ = timestamp;
+  if (targets_.empty())
+    return results_;
+
+  // 1.构建所有目标共用的帧金字塔，层数取各目标的最大值，各层的缓存跨帧复用
+  int num_levels = 1;
+  for (const auto &t : targets_)
+    num_levels = std::max(num_levels, t.tracker->numLevels());
+  frame_pyr_.resize(num_levels);
+  frame_pyr_[0] = I;
+  for (int i = 1; i < num_levels; ++i)
+    imgproc::PyrDown(frame_pyr_[i - 1], frame_pyr_[i]);
+
+  // 2.每个目标一个任务，模板大的先提交
+  for (int k : order_) {
+    pool_.submit([this, k, timestamp]() {
+      Target &target = targets_[k];
+      TargetResult &r = results_[k];
+      r.id = target.id;
+      try {
+        r.result = target.tracker->Track(frame_pyr_, timestamp);
+        r.failed = false;
+      } catch (...) {
+        // 失败只影响该目标，由结果的状态告知调用者
+        r.result = Result();
+        r.result.status = OptimizerStatus::Failed;
+        r.result.successful = false;
+        r.failed = true;
+      }
+    });
+  }
+
+  // 3.调用线程也参与执行，等待所有目标完成
+  pool_.wait();
+  frame_pyr_[0].release();
+  return results_;
+}
+
+template<class M>
+void MultiTargetTracker<M>::UpdateOrder() {
+  order_.resize(targets_.size());
+  for (size_t i = 0; i < order_.size(); ++i)
+    order_[i] = static_cast<int>(i);
+  std::stable_sort(order_.begin(), order_.end(),
+                   [this](int a, int b) { return targets_[a].area > targets_[b].area; });
+}
+
+template
+class MultiTargetTracker<Homography>;
+
+NAMESPACE_END
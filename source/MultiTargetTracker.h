@@ -0,0 +1,118 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/01 11:02
+ * @Description: MultiTargetTracker
+ * @FilePath: Bitplanes/source/MultiTargetTracker.h
+ */
+#pragma once
+
+#include "API.h"
+#include "Types.h"
+#include "Parameters.h"
+#include "Tracker.h"
+#include "ThreadPool.h"
+
+#include <opencv2/opencv.hpp>
+#include <memory>
+#include <vector>
+
+NAMESPACE_BEGIN
+/**
+ * Tracks several templates in the same frames
+ *
+ * The frame pyramid is built once per frame and shared by all the targets,
+ * each target is then tracked as one task of a work-stealing thread pool.
+ * The levels of one target depend on each other (coarse to fine), so the
+ * unit of work is the target; the largest templates are queued first so
+ * that the long tasks do not end up last.
+ *
+ * The results are the same as tracking each target with its own
+ * PyramidTracker on the shared pyramid. The instance itself must be used
+ * from one thread at a time
+ */
+template<class M>
+class MultiTargetTracker {
+public:
+  typedef PyramidTracker<M> TrackerType;
+  typedef int TargetId;
+
+  /**
+   * result of one target for the last frame
+   */
+  struct TargetResult {
+    TargetId id = -1;
+    Result result;
+    bool failed = false;  //< the tracker threw, result has the status OptimizerStatus::Failed
+  };
+
+public:
+  /**
+   * \param p parameters used by all the targets
+   * \param num_threads number of workers, <= 0 means one per hardware thread
+   */
+  explicit MultiTargetTracker(Parameters p = Parameters(), int num_threads = 0);
+
+  /**
+   * Adds a target
+   *
+   * \param I the image containing the template
+   * \param bbox location of the template in I
+   * \return id of the target, unique for this instance
+   */
+  TargetId addTarget(const cv::Mat &I, const cv::Rect &bbox);
+
+  /**
+   * \return false if there is no target with this id
+   */
+  bool removeTarget(TargetId id);
+
+  inline int numTargets() const { return static_cast<int>(targets_.size()); }
+
+  /**
+   * \return the tracker of a target, nullptr if there is no target with this id
+   */
+  TrackerType *tracker(TargetId id);
+
+  /**
+   * Tracks all the targets, the frame is assumed to be one time unit after
+   * the previous one
+   */
+  const std::vector<TargetResult> &Track(const cv::Mat &I) {
+    return Track(I, time_ + 1.0);
+  }
+
+  /**
+   * Tracks all the targets
+   *
+   * \param I input image
+   * \param timestamp time of the frame, used by the motion predictors
+   * \return one result per target, in the order the targets were added. The
+   * reference is valid until the next call
+   */
+  const std::vector<TargetResult> &Track(const cv::Mat &I, double timestamp);
+
+private:
+  struct Target {
+    TargetId id;
+    std::unique_ptr<TrackerType> tracker;
+    int area;  //< template area, used to order the tasks
+  };
+
+  /**
+   * sorts the task order by decreasing template area
+   */
+  void UpdateOrder();
+
+private:
+  Parameters params_;
+  ThreadPool pool_;
+  std::vector<Target> targets_;
+  std::vector<int> order_;                //< indices of targets_, largest first
+  std::vector<TargetResult> results_;
+  std::vector<cv::Mat> frame_pyr_;        //< pyramid shared by the targets
+  TargetId next_id_ = 0;
+  double time_ = 0.0;
+};
+
+NAMESPACE_END
@@ -37,14 +37,44 @@ std::string ToString(Parameters::MultiChannelExtractorType m) {
   return ret;
 }
 
+std::string ToString(Parameters::MotionPredictorType m) {
+  std::string ret;
+  switch (m) {
+    case Parameters::MotionPredictorType::None:
+      ret = "None";
+      break;
+    case Parameters::MotionPredictorType::ConstantVelocity:
+      ret = "ConstantVelocity";
+      break;
+    case Parameters::MotionPredictorType::Kalman:
+      ret = "Kalman";
+      break;
+  }
+  return ret;
+}
+
 std::ostream &operator<<(std::ostream &os, const Parameters &p) {
   os << "MultiChannelFunction = " << ToString(p.multi_channel_function) << "\n";
   os << "ParameterTolerance = " << p.parameter_tolerance << "\n";
   os << "FunctionTolerance = " << p.function_tolerance << "\n";
   os << "NumLevels = " << p.num_levels << "\n";
+  os << "MaxTimeMicroSeconds = " << p.max_time_us << "\n";
+  os << "AbortOnDivergence = " << p.abort_on_divergence << "\n";
+  os << "MaxCostIncreases = " << p.max_cost_increases << "\n";
+  os << "MaxStepNorm = " << p.max_step_norm << "\n";
+  os << "RevertToBest = " << p.revert_to_best << "\n";
+  os << "UnchangedFrameThreshold = " << p.unchanged_frame_threshold << "\n";
   os << "sigma = " << p.sigma << "\n";
+  os << "SearchMargin = " << p.search_margin << "\n";
   os << "verbose = " << p.verbose << "\n";
-  os << "subsampling = " << p.subsampling;
+  os << "subsampling = " << p.subsampling << "\n";
+  os << "adaptive_levels = " << p.adaptive_levels << "\n";
+  os << "level_motion_pixels = " << p.level_motion_pixels << "\n";
+  os << "tile_size = " << p.tile_size << "\n";
+  os << "occlusion_threshold = " << p.occlusion_threshold << "\n";
+  os << "num_hypotheses = " << p.num_hypotheses << "\n";
+  os << "huge_pages = " << p.huge_pages << "\n";
+  os << "motion_predictor = " << ToString(p.motion_predictor);
   return os;
 }
 NAMESPACE_END
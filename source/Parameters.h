@@ -37,6 +37,15 @@ public:
     ForwardCompositional, //< FC algorithm
   };
 
+  /**
+   * predictor used to initialize each frame from the previous poses
+   */
+  enum class MotionPredictorType {
+    None,                 //< use the previous pose
+    ConstantVelocity,     //< constant velocity on the sl(3) parameters
+    Kalman,               //< constant velocity with a Kalman filtered velocity
+  };
+
   /**
    * Type of the motion to estimate
    */
@@ -69,6 +78,56 @@ public:
    */
   float function_tolerance = 5e-5;
 
+  /**
+   * wall-clock budget, in microseconds, to track one frame. PyramidTracker
+   * splits it across the levels by their number of template pixels. When the
+   * budget is spent, the best estimate so far is returned with the status
+   * OptimizerStatus::TimeBudgetExceeded. A value <= 0 means no budget
+   */
+  float max_time_us = 0.0f;
+
+  /**
+   * abort the optimization with OptimizerStatus::Diverged when the cost
+   * increases over 'max_cost_increases' consecutive iterations, the norm of the
+   * step exceeds 'max_step_norm', or the transform becomes degenerate.
+   * PyramidTracker skips the remaining finer levels of a diverged frame
+   */
+  bool abort_on_divergence = false;
+
+  /**
+   * number of consecutive cost increases considered a divergence, <= 0 disables
+   */
+  int max_cost_increases = 3;
+
+  /**
+   * largest norm of the parameter step (normalized coordinates), <= 0 disables
+   */
+  float max_step_norm = 2.0f;
+
+  /**
+   * return the lowest cost pose seen when the optimization diverges, instead of
+   * the last one
+   */
+  bool revert_to_best = true;
+
+  /**
+   * restrict the per-frame preprocessing (image pyramid and smoothing) to the
+   * template location predicted by the initialization, enlarged on each side
+   * by this fraction of its size. Warps that leave this region see zeros.
+   * A negative value processes the whole image
+   */
+  float search_margin = -1.0f;
+
+  /**
+   * PyramidTracker compares a sparse grid of samples of the template location
+   * with the last tracked frame. If their mean absolute difference (in gray
+   * levels) is below this value, the previous result is returned with the
+   * status OptimizerStatus::FrameUnchanged. A frame given an initial pose
+   * other than the previous one is always tracked. A value <= 0 disables the
+   * test
+   */
+  float unchanged_frame_threshold = 0.0f;
+
   /**
    * std. deviation of an isotropic Gaussian to pre-smooth images prior to
    * computing the channels
@@ -90,6 +149,56 @@ public:
    */
   int subsampling = 1;
 
+  /**
+   * Select the range of pyramid levels per frame.
+   *
+   * The coarsest level is chosen from the expected motion of the template
+   * corners, the finest level from the scale of the projected template. Only
+   * the image levels in that range (and those needed to get there) are built.
+   */
+  bool adaptive_levels = false;
+
+  /**
+   * Motion, in pixels of a pyramid level, that a single level is expected to
+   * recover. Used by 'adaptive_levels' to pick the coarsest level
+   */
+  float level_motion_pixels = 2.0f;
+
+  /**
+   * Split the template into square tiles of this side, in pixels of each
+   * pyramid level, linearized in parallel. Tiles that look occluded are
+   * dropped from the solve, see 'occlusion_threshold'. <= 0 disables tiling
+   */
+  int tile_size = 0;
+
+  /**
+   * A tile is dropped during Track when the fraction of its LBP bits that do
+   * not match the template exceeds this value and twice the median of the
+   * tiles. Unrelated content gives about 0.5. <= 0 keeps all the tiles
+   */
+  float occlusion_threshold = 0.3f;
+
+  /**
+   * Number of initializations PyramidTracker::Track runs concurrently: the
+   * predicted pose, the previous pose, the last pose that was not lost and
+   * the template pose, in that order, skipping duplicates. The converged
+   * result with the lowest cost wins; once one of them converges, the others
+   * stop as soon as their cost is more than twice its cost.
+   * Uses num_hypotheses - 1 worker threads, 1 runs the predicted pose only
+   */
+  int num_hypotheses = 1;
+
+  /**
+   * back the memory of the template data and tracking buffers with huge pages
+   * when the system supports them (Linux), regular pages otherwise
+   */
+  bool huge_pages = false;
+
+  /**
+   * motion prediction used by PyramidTracker::Track when no pose is given
+   */
+  MotionPredictorType motion_predictor = MotionPredictorType::None;
+
   /**
    * Multi-channel function to use
    *
@@ -0,0 +1,283 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/11 10:45
+ * @Description: PipelinedTracker
+ * @FilePath: Bitplanes/source/PipelinedTracker.cc
+ */
+#include "PipelinedTracker.h"
+#include "MotionModel.h"
+#include "Filter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <exception>
+
+NAMESPACE_BEGIN
+/**
+ * converts a gray or BGR(A) image to gray, gray images are shared
+ */
+static void ToGray(const cv::Mat &src, cv::Mat &dst) {
+  if (src.channels() == 3)
+    cv::cvtColor(src, dst, cv::COLOR_BGR2GRAY);
+  else if (src.channels() == 4)
+    cv::cvtColor(src, dst, cv::COLOR_BGRA2GRAY);
+  else
+    dst = src;
+}
+
+template<class M>
+PipelinedTracker<M>::PipelinedTracker(Parameters p, int depth)
+  : tracker_(p), slots_(std::max(1, depth)) {
+  preprocess_thread_ = std::thread(&PipelinedTracker::preprocessLoop, this);
+  track_thread_ = std::thread(&PipelinedTracker::trackLoop, this);
+}
+
+template<class M>
+PipelinedTracker<M>::~PipelinedTracker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  preprocess_thread_.join();
+  track_thread_.join();
+
+  // 未跟踪的帧的 future 与回调以取消的状态结束
+  const int64_t depth = static_cast<int64_t>(slots_.size());
+  for (int64_t i = num_tracked_; i < num_pushed_; ++i) {
+    Slot &s = slots_[i % depth];
+    FrameResult r;
+    r.frame = s.index;
+    r.timestamp = s.timestamp;
+    r.image = s.image;
+    r.result.status = OptimizerStatus::Cancelled;
+    r.result.successful = false;
+    if (s.has_promise)
+      s.promise.set_value(r.result);
+    else if (s.callback)
+      s.callback(r);
+  }
+}
+
+template<class M>
+void PipelinedTracker<M>::setTemplate(const cv::Mat &I, const cv::Rect &bbox) {
+  waitIdle();
+
+  // 1.流水线空闲时跟踪线程不使用跟踪器，模板可以在调用线程上设置
+  cv::Mat gray;
+  ToGray(I, gray);
+  tracker_.setTemplate(gray, bbox);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  num_levels_ = tracker_.numLevels();
+}
+
+template<class M>
+int64_t PipelinedTracker<M>::push(const cv::Mat &I, double timestamp) {
+  return Push(I, timestamp, nullptr, Callback());
+}
+
+template<class M>
+std::future<Result> PipelinedTracker<M>::TrackAsync(const cv::Mat &I, double timestamp) {
+  std::promise<Result> promise;
+  std::future<Result> ret = promise.get_future();
+  Push(I, timestamp, &promise, Callback());
+  return ret;
+}
+
+template<class M>
+int64_t PipelinedTracker<M>::TrackAsync(const cv::Mat &I, double timestamp, Callback callback) {
+  assert(callback);
+  return Push(I, timestamp, nullptr, std::move(callback));
+}
+
+template<class M>
+int PipelinedTracker<M>::cancelPending() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return CancelPending();
+}
+
+template<class M>
+void PipelinedTracker<M>::setDropStale(bool drop_stale) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  drop_stale_ = drop_stale;
+}
+
+template<class M>
+int64_t PipelinedTracker<M>::Push(const cv::Mat &I, double timestamp, std::promise<Result> *promise,
+                                  Callback callback) {
+  const int64_t depth = static_cast<int64_t>(slots_.size());
+  std::unique_lock<std::mutex> lock(mutex_);
+  assert(num_levels_ > 0 && "setTemplate must be called before push");
+
+  // 1.只跟踪最新帧时，取消还未开始跟踪的帧，它们很快让出槽
+  if (drop_stale_)
+    CancelPending();
+
+  // 2.等待最旧的帧跟踪完成，腾出它的槽
+  done_cv_.wait(lock, [this, depth]() { return num_pushed_ - num_tracked_ < depth; });
+  Slot &s = slots_[num_pushed_ % depth];
+  s.image = I;
+  s.timestamp = timestamp;
+  s.index = num_pushed_++;
+  s.cancelled = false;
+  s.has_promise = promise != nullptr;
+  if (promise)
+    s.promise = std::move(*promise);
+  s.callback = std::move(callback);
+  if (!s.has_promise && !s.callback)
+    ++num_to_pop_;
+  time_ = timestamp;
+  work_cv_.notify_all();
+  return s.index;
+}
+
+template<class M>
+int PipelinedTracker<M>::CancelPending() {
+  const int64_t depth = static_cast<int64_t>(slots_.size());
+  int ret = 0;
+  for (int64_t i = num_tracked_ + (tracking_ ? 1 : 0); i < num_pushed_; ++i) {
+    Slot &s = slots_[i % depth];
+    ret += s.cancelled ? 0 : 1;
+    s.cancelled = true;
+  }
+  return ret;
+}
+
+template<class M>
+bool PipelinedTracker<M>::pop(FrameResult &r) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this]() { return !results_.empty() || num_to_pop_ == 0; });
+  if (results_.empty())
+    return false;
+
+  r = std::move(results_.front());
+  results_.pop_front();
+  return true;
+}
+
+template<class M>
+bool PipelinedTracker<M>::tryPop(FrameResult &r) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (results_.empty())
+    return false;
+
+  r = std::move(results_.front());
+  results_.pop_front();
+  return true;
+}
+
+template<class M>
+void PipelinedTracker<M>::waitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this]() { return num_tracked_ == num_pushed_; });
+}
+
+template<class M>
+int PipelinedTracker<M>::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int>(num_pushed_ - num_tracked_) + static_cast<int>(results_.size());
+}
+
+template<class M>
+void PipelinedTracker<M>::Preprocess(Slot &s, int num_levels) {
+  // 1.转为灰度图，灰度输入直接共享
+  s.pyr.resize(num_levels);
+  if (s.image.channels() == 1) {
+    s.pyr[0] = s.image;
+  } else {
+    ToGray(s.image, s.gray);
+    s.pyr[0] = s.gray;
+  }
+
+  // 2.构建整帧的金字塔，各层的缓存跨帧复用
+  for (int i = 1; i < num_levels; ++i)
+    imgproc::PyrDown(s.pyr[i - 1], s.pyr[i]);
+}
+
+template<class M>
+void PipelinedTracker<M>::preprocessLoop() {
+  const int64_t depth = static_cast<int64_t>(slots_.size());
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    // 1.取下一个已入队的帧
+    work_cv_.wait(lock, [this]() { return stop_ || num_preprocessed_ < num_pushed_; });
+    if (stop_)
+      return;
+
+    // 2.在锁外预处理，push 不会复用尚未跟踪的槽；已取消的帧不预处理
+    Slot &s = slots_[num_preprocessed_ % depth];
+    const int num_levels = num_levels_;
+    const bool cancelled = s.cancelled;
+    lock.unlock();
+    if (!cancelled)
+      Preprocess(s, num_levels);
+    lock.lock();
+    ++num_preprocessed_;
+    work_cv_.notify_all();
+  }
+}
+
+template<class M>
+void PipelinedTracker<M>::trackLoop() {
+  const int64_t depth = static_cast<int64_t>(slots_.size());
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    // 1.按顺序取下一个已预处理的帧
+    work_cv_.wait(lock, [this]() { return stop_ || num_tracked_ < num_preprocessed_; });
+    if (stop_)
+      return;
+
+    // 2.在锁外跟踪，跟踪器只在这个线程上使用；开始跟踪后不能再取消
+    Slot &s = slots_[num_tracked_ % depth];
+    const bool cancelled = s.cancelled;
+    tracking_ = true;
+    lock.unlock();
+    FrameResult r;
+    std::exception_ptr error;
+    r.frame = s.index;
+    r.timestamp = s.timestamp;
+    r.image = s.image;
+    if (cancelled) {
+      r.result.status = OptimizerStatus::Cancelled;
+      r.result.successful = false;
+    } else {
+      try {
+        r.result = tracker_.Track(s.pyr, s.timestamp);
+      } catch (...) {
+        error = std::current_exception();
+        r.result = Result();
+        r.result.status = OptimizerStatus::Failed;
+        r.result.successful = false;
+      }
+      s.pyr[0].release();
+    }
+    s.image.release();
+
+    // 3.按帧的顺序交给 future、回调或 pop 的队列，回调返回后才释放槽；
+    //   future 上重新抛出跟踪时的异常
+    const bool to_pop = !s.has_promise && !s.callback;
+    if (s.has_promise && error)
+      s.promise.set_exception(error);
+    else if (s.has_promise)
+      s.promise.set_value(r.result);
+    else if (s.callback)
+      s.callback(r);
+    s.has_promise = false;
+    s.callback = Callback();
+    lock.lock();
+    if (to_pop) {
+      results_.push_back(std::move(r));
+      --num_to_pop_;
+    }
+    ++num_tracked_;
+    tracking_ = false;
+    done_cv_.notify_all();
+  }
+}
+
+template
+class PipelinedTracker<Homography>;
+
+NAMESPACE_END
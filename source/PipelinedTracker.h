@@ -0,0 +1,238 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/11 10:20
+ * @Description: PipelinedTracker
+ * @FilePath: Bitplanes/source/PipelinedTracker.h
+ */
+#pragma once
+
+#include "API.h"
+#include "Types.h"
+#include "Parameters.h"
+#include "Tracker.h"
+
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+NAMESPACE_BEGIN
+/**
+ * Tracks a template in a video, preprocessing the next frames while the
+ * current one is tracked
+ *
+ * The frames go through two stages, each on its own thread: the
+ * preprocessing (gray conversion and the frame pyramid) and the tracking
+ * with a PyramidTracker. Up to depth frames are in the pipeline at once, so
+ * the pyramid of frame t + 1 is built while frame t is tracked, and the
+ * caller decodes frame t + 2 in the meantime. The throughput is the one of
+ * the slowest stage instead of the sum of the stages. The smoothing of the
+ * frame stays in the tracking stage, it only covers the search region
+ * predicted from the previous pose
+ *
+ * The results are the same as tracking the frames one after the other with
+ * PyramidTracker::Track on their full pyramid, and come back in the order
+ * the frames were pushed. A frame given to TrackAsync reports its result
+ * through a future or a callback instead of pop, in the same order. Frames
+ * that did not start tracking can be cancelled, e.g. to always track the
+ * newest frame of a live stream
+ *
+ * push, TrackAsync, pop, tryPop, cancelPending, waitIdle and pending are
+ * thread-safe, e.g. a capture thread pushes the frames and a display thread
+ * pops the results; setTemplate and tracker must not be used while another
+ * thread pushes frames
+ */
+template<class M>
+class PipelinedTracker {
+public:
+  typedef PyramidTracker<M> TrackerType;
+
+  /**
+   * result of one frame
+   */
+  struct FrameResult {
+    int64_t frame = -1;      //< index of the frame, in push order
+    double timestamp = 0.0;  //< timestamp given to push
+    cv::Mat image;           //< the frame given to push
+    Result result;           //< status OptimizerStatus::Cancelled if the frame was cancelled,
+                             //< OptimizerStatus::Failed if the tracker threw
+  };
+
+  typedef std::function<void(const FrameResult &)> Callback;
+
+public:
+  /**
+   * \param p parameters of the tracker
+   * \param depth number of frames that can be in the pipeline, >= 2 for the
+   * stages to overlap
+   */
+  explicit PipelinedTracker(Parameters p = Parameters(), int depth = 2);
+
+  /**
+   * finishes the frames being processed, drops the other ones. The futures
+   * and callbacks of the dropped frames get them as cancelled
+   */
+  ~PipelinedTracker();
+
+  PipelinedTracker(const PipelinedTracker &) = delete;
+
+  PipelinedTracker &operator=(const PipelinedTracker &) = delete;
+
+  /**
+   * sets the template, once the frames in the pipeline are tracked. Their
+   * results stay available to pop
+   *
+   * \param I reference image, gray or BGR(A)
+   * \param bbox template location
+   */
+  void setTemplate(const cv::Mat &I, const cv::Rect &bbox);
+
+  /**
+   * queues a frame, blocks while depth frames are waiting to be tracked. The
+   * frame data is shared, not copied: it must not be modified until its
+   * result is popped
+   *
+   * \param I the frame, gray or BGR(A)
+   * \param timestamp time of the frame, used by the motion predictor
+   * \return the index of the frame
+   */
+  int64_t push(const cv::Mat &I, double timestamp);
+
+  /**
+   * queues a frame one time unit after the previous one
+   */
+  int64_t push(const cv::Mat &I) {
+    return push(I, time_ + 1.0);
+  }
+
+  /**
+   * queues a frame like push, its result is reported through the future
+   * instead of pop
+   *
+   * \return the result of the frame, ready once the frames pushed before it
+   * are done. If the tracker threw, get() rethrows the exception
+   */
+  std::future<Result> TrackAsync(const cv::Mat &I, double timestamp);
+
+  /**
+   * queues a frame like push, its result is reported through the callback
+   * instead of pop
+   *
+   * \param callback called on the tracking thread, in frame order
+   * \return the index of the frame
+   */
+  int64_t TrackAsync(const cv::Mat &I, double timestamp, Callback callback);
+
+  /**
+   * cancels the frames that did not start tracking. They are reported in
+   * order like the other frames, with the status OptimizerStatus::Cancelled
+   * and an invalid pose
+   *
+   * \return the number of cancelled frames
+   */
+  int cancelPending();
+
+  /**
+   * when set, each new frame cancels the frames that did not start tracking,
+   * so that the tracker always takes the newest one. Needs depth >= 3 for the
+   * new frame to not wait for the one being tracked
+   */
+  void setDropStale(bool drop_stale);
+
+  /**
+   * takes the result of the oldest frame not popped yet, waits until it is
+   * tracked
+   *
+   * \return false if all the pushed frames were popped
+   */
+  bool pop(FrameResult &r);
+
+  /**
+   * same as pop, without waiting
+   *
+   * \return false if the result of the oldest frame is not ready
+   */
+  bool tryPop(FrameResult &r);
+
+  /**
+   * waits until all the pushed frames are tracked
+   */
+  void waitIdle();
+
+  /**
+   * \return the number of frames in the pipeline plus the results waiting for
+   * pop
+   */
+  int pending() const;
+
+  /**
+   * \return the tracker, e.g. to set a motion predictor. Must only be used
+   * after waitIdle and before the next push
+   */
+  inline TrackerType &tracker() { return tracker_; }
+
+private:
+  /**
+   * a frame in the pipeline, the slots are reused frame after frame
+   */
+  struct Slot {
+    cv::Mat image;             //< the frame given to push
+    cv::Mat gray;              //< buffer of the gray conversion
+    std::vector<cv::Mat> pyr;  //< frame pyramid, the levels are reused across frames
+    double timestamp;
+    int64_t index;
+    bool cancelled = false;
+    bool has_promise = false;     //< the result goes to promise
+    std::promise<Result> promise;
+    Callback callback;            //< the result goes to callback if set, to pop otherwise
+  };
+
+  /**
+   * queues a frame, see push and TrackAsync
+   *
+   * \param promise if not nullptr, receives the result
+   * \param callback if set, receives the result
+   */
+  int64_t Push(const cv::Mat &I, double timestamp, std::promise<Result> *promise, Callback callback);
+
+  /**
+   * cancels the frames that did not start tracking. Must hold mutex_
+   */
+  int CancelPending();
+
+  /**
+   * converts the frame of the slot to gray and builds its pyramid
+   */
+  void Preprocess(Slot &s, int num_levels);
+
+  void preprocessLoop();
+
+  void trackLoop();
+
+private:
+  TrackerType tracker_;
+  std::vector<Slot> slots_;           //< frame n is in slots_[n % depth]
+  std::deque<FrameResult> results_;   //< tracked frames not popped yet
+  std::thread preprocess_thread_;
+  std::thread track_thread_;
+  mutable std::mutex mutex_;          //< protects the counters, results_ and stop_
+  std::condition_variable work_cv_;   //< signaled when a frame is pushed or preprocessed
+  std::condition_variable done_cv_;   //< signaled when a frame is tracked
+  int64_t num_pushed_ = 0;
+  int64_t num_preprocessed_ = 0;
+  int64_t num_tracked_ = 0;
+  int64_t num_to_pop_ = 0;            //< frames of push whose result is not in results_ yet
+  bool tracking_ = false;             //< the frame num_tracked_ is being tracked
+  bool drop_stale_ = false;
+  int num_levels_ = 0;                //< pyramid levels of the template, 0 before setTemplate
+  double time_ = 0.0;
+  bool stop_ = false;
+};
+
+NAMESPACE_END
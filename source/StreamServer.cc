@@ -0,0 +1,258 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/04 10:15
+ * @Description: StreamServer
+ * @FilePath: Bitplanes/source/StreamServer.cc
+ */
+#include "StreamServer.h"
+#include "MotionModel.h"
+
+#include <algorithm>
+
+NAMESPACE_BEGIN
+template<class Duration>
+static inline float ToMilliseconds(const Duration &d) {
+  return std::chrono::duration<float, std::milli>(d).count();
+}
+
+template<class M>
+StreamServer<M>::StreamServer(Parameters p, int num_workers)
+  : params_(p) {
+  if (num_workers <= 0)
+    num_workers = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 0; i < num_workers; ++i)
+    workers_.emplace_back(&StreamServer::workerLoop, this);
+}
+
+template<class M>
+StreamServer<M>::~StreamServer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    for (auto &it : streams_) {
+      it.second->stats.dropped += static_cast<int64_t>(it.second->queue.size());
+      it.second->queue.clear();
+    }
+  }
+  work_cv_.notify_all();
+  for (auto &w : workers_)
+    w.join();
+}
+
+template<class M>
+typename StreamServer<M>::StreamId
+StreamServer<M>::addStream(float deadline_ms, Callback callback, int max_queued) {
+  std::shared_ptr<Stream> s(new Stream);
+  s->deadline = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(deadline_ms));
+  s->callback = std::move(callback);
+  s->max_queued = static_cast<size_t>(std::max(1, max_queued));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  s->id = next_id_++;
+  s->result.stream = s->id;
+  streams_[s->id] = s;
+  return s->id;
+}
+
+template<class M>
+bool StreamServer<M>::removeStream(StreamId id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto s = Acquire(id, lock);
+  if (!s)
+    return false;
+
+  streams_.erase(id);
+  idle_cv_.notify_all();
+  return true;
+}
+
+template<class M>
+int StreamServer<M>::addTarget(StreamId id, const cv::Mat &I, const cv::Rect &bbox) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto s = Acquire(id, lock);
+  if (!s)
+    return -1;
+
+  // 1.模板在锁外构建，期间流标记为忙，工作线程不会使用它的跟踪器
+  lock.unlock();
+  std::unique_ptr<TrackerType> tracker(new TrackerType(params_));
+  tracker->setTemplate(I, bbox);
+
+  // 2.加入跟踪器并释放流
+  lock.lock();
+  s->trackers.push_back(std::move(tracker));
+  s->busy = false;
+  idle_cv_.notify_all();
+  work_cv_.notify_one();
+  return static_cast<int>(s->trackers.size()) - 1;
+}
+
+template<class M>
+bool StreamServer<M>::submit(StreamId id, const cv::Mat &I, double timestamp) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = streams_.find(id);
+    if (it == streams_.end())
+      return false;
+
+    // 1.队列已满时丢弃最旧的帧，保证处理的总是最新的帧
+    Stream &s = *it->second;
+    const auto now = Clock::now();
+    if (s.queue.size() >= s.max_queued) {
+      s.queue.pop_front();
+      ++s.stats.dropped;
+    }
+    if (s.stats.submitted++ == 0)
+      s.first_submit = now;
+    s.queue.push_back(Frame{I, timestamp, s.next_index++, now, now + s.deadline});
+  }
+  work_cv_.notify_one();
+  return true;
+}
+
+template<class M>
+void StreamServer<M>::waitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this]() {
+    if (num_busy_ > 0)
+      return false;
+    for (const auto &it : streams_) {
+      if (!it.second->queue.empty())
+        return false;
+    }
+    return true;
+  });
+}
+
+template<class M>
+typename StreamServer<M>::Stats StreamServer<M>::stats(StreamId id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = streams_.find(id);
+  if (it == streams_.end())
+    return Stats();
+
+  const Stream &s = *it->second;
+  Stats ret = s.stats;
+  if (ret.processed > 0) {
+    ret.mean_latency_ms = static_cast<float>(s.latency_sum_ms / static_cast<double>(ret.processed));
+    const float elapsed_ms = ToMilliseconds(Clock::now() - s.first_submit);
+    ret.fps = elapsed_ms > 0.0f ? 1000.0f * static_cast<float>(ret.processed) / elapsed_ms : 0.0f;
+  }
+  return ret;
+}
+
+template<class M>
+std::shared_ptr<typename StreamServer<M>::Stream> StreamServer<M>::NextFrame(Frame &frame) {
+  const auto now = Clock::now();
+  std::shared_ptr<Stream> best;
+  for (auto &it : streams_) {
+    Stream &s = *it.second;
+    if (s.busy || s.queue.empty())
+      continue;
+
+    // 1.已过截止时间且有更新的帧在等待时，跳过该帧
+    while (s.queue.size() > 1 && s.queue.front().deadline < now) {
+      s.queue.pop_front();
+      ++s.stats.dropped;
+    }
+
+    // 2.选择截止时间最早的帧
+    if (!best || s.queue.front().deadline < best->queue.front().deadline)
+      best = it.second;
+  }
+
+  if (best) {
+    frame = std::move(best->queue.front());
+    best->queue.pop_front();
+    best->busy = true;
+  }
+  return best;
+}
+
+template<class M>
+void StreamServer<M>::TrackFrame(Stream &s, const Frame &frame) {
+  FrameResult &r = s.result;
+  r.frame = frame.index;
+  r.timestamp = frame.timestamp;
+  r.results.resize(s.trackers.size());
+  if (s.trackers.empty())
+    return;
+
+  // 1.构建流内所有目标共用的帧金字塔
+  int num_levels = 1;
+  for (const auto &t : s.trackers)
+    num_levels = std::max(num_levels, t->numLevels());
+  s.pyr.resize(num_levels);
+  s.pyr[0] = frame.image;
+  for (int i = 1; i < num_levels; ++i)
+    imgproc::PyrDown(s.pyr[i - 1], s.pyr[i]);
+
+  // 2.依次跟踪各个目标，一个目标失败不影响其它目标
+  for (size_t k = 0; k < s.trackers.size(); ++k) {
+    try {
+      r.results[k] = s.trackers[k]->Track(s.pyr, frame.timestamp);
+    } catch (...) {
+      r.results[k] = Result();
+      r.results[k].status = OptimizerStatus::Failed;
+      r.results[k].successful = false;
+    }
+  }
+  s.pyr[0].release();
+}
+
+template<class M>
+std::shared_ptr<typename StreamServer<M>::Stream>
+StreamServer<M>::Acquire(StreamId id, std::unique_lock<std::mutex> &lock) {
+  for (;;) {
+    auto it = streams_.find(id);
+    if (it == streams_.end())
+      return nullptr;
+    if (!it->second->busy) {
+      it->second->busy = true;
+      return it->second;
+    }
+    idle_cv_.wait(lock);
+  }
+}
+
+template<class M>
+void StreamServer<M>::workerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    // 1.取截止时间最早的帧
+    Frame frame;
+    std::shared_ptr<Stream> s;
+    while (!stop_ && !(s = NextFrame(frame)))
+      work_cv_.wait(lock);
+    if (!s)
+      return;
+    ++num_busy_;
+
+    // 2.在锁外跟踪并回调，流保持忙碌状态，同一个流的帧按顺序处理
+    lock.unlock();
+    TrackFrame(*s, frame);
+    const auto done = Clock::now();
+    s->result.latency_ms = ToMilliseconds(done - frame.submitted);
+    s->result.deadline_missed = done > frame.deadline;
+    if (s->callback)
+      s->callback(s->result);
+    frame.image.release();
+
+    // 3.更新统计并释放流
+    lock.lock();
+    Stats &stats = s->stats;
+    ++stats.processed;
+    stats.deadline_misses += s->result.deadline_missed ? 1 : 0;
+    stats.max_latency_ms = std::max(stats.max_latency_ms, s->result.latency_ms);
+    s->latency_sum_ms += s->result.latency_ms;
+    s->busy = false;
+    --num_busy_;
+    idle_cv_.notify_all();
+  }
+}
+
+template
+class StreamServer<Homography>;
+
+NAMESPACE_END
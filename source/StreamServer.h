@@ -0,0 +1,203 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/04 09:40
+ * @Description: StreamServer
+ * @FilePath: Bitplanes/source/StreamServer.h
+ */
+#pragma once
+
+#include "API.h"
+#include "Types.h"
+#include "Parameters.h"
+#include "Tracker.h"
+
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+NAMESPACE_BEGIN
+/**
+ * Tracks the targets of many camera or video streams on a fixed number of
+ * worker threads
+ *
+ * Each stream has its own trackers and a latency deadline. A frame submitted
+ * to a stream must be done within the deadline; the workers always take the
+ * queued frame with the earliest deadline (EDF), so a stream with a lot of
+ * targets does not delay the others beyond their deadlines. The frames of one
+ * stream are tracked in order, one at a time. A stream that falls behind
+ * drops frames: a frame that does not fit in the queue of the stream replaces
+ * the oldest queued one, and a queued frame past its deadline is skipped when
+ * a newer one is waiting
+ *
+ * All the methods are thread-safe. The callbacks are called on the workers
+ */
+template<class M>
+class StreamServer {
+public:
+  typedef PyramidTracker<M> TrackerType;
+  typedef int StreamId;
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * results of one frame
+   */
+  struct FrameResult {
+    StreamId stream = -1;
+    int64_t frame = -1;           //< index of the frame in the stream
+    double timestamp = 0.0;       //< timestamp given to submit
+    std::vector<Result> results;  //< one per target, in the order they were added; a target
+                                  //< that threw has the status OptimizerStatus::Failed
+    float latency_ms = 0.0f;      //< from submit to the end of tracking
+    bool deadline_missed = false;
+  };
+
+  typedef std::function<void(const FrameResult &)> Callback;
+
+  /**
+   * latency and throughput counters of a stream
+   */
+  struct Stats {
+    int64_t submitted = 0;        //< frames given to submit
+    int64_t processed = 0;        //< frames tracked
+    int64_t dropped = 0;          //< frames dropped because the stream fell behind
+    int64_t deadline_misses = 0;  //< frames tracked after their deadline
+    float mean_latency_ms = 0.0f;
+    float max_latency_ms = 0.0f;
+    float fps = 0.0f;             //< processed frames per second since the first submit
+  };
+
+public:
+  /**
+   * \param p parameters of the trackers
+   * \param num_workers number of worker threads, <= 0 means one per hardware
+   * thread
+   */
+  explicit StreamServer(Parameters p = Parameters(), int num_workers = 0);
+
+  /**
+   * finishes the frames being tracked, drops the queued ones
+   */
+  ~StreamServer();
+
+  StreamServer(const StreamServer &) = delete;
+
+  StreamServer &operator=(const StreamServer &) = delete;
+
+  /**
+   * Adds a stream
+   *
+   * \param deadline_ms latency deadline of the frames of the stream
+   * \param callback called with the results of each tracked frame, in frame
+   * order
+   * \param max_queued number of frames that can wait for a worker
+   */
+  StreamId addStream(float deadline_ms, Callback callback = Callback(), int max_queued = 1);
+
+  /**
+   * removes a stream, waits until its frame being tracked, if any, is done.
+   * Queued frames are dropped
+   *
+   * \return false if there is no stream with this id
+   */
+  bool removeStream(StreamId id);
+
+  /**
+   * adds a target to a stream, waits until the frame of the stream being
+   * tracked, if any, is done
+   *
+   * \return index of the target in FrameResult::results, -1 if there is no
+   * stream with this id
+   */
+  int addTarget(StreamId id, const cv::Mat &I, const cv::Rect &bbox);
+
+  /**
+   * queues a frame of a stream. The frame data is shared, not copied: it must
+   * not be modified until its result is reported
+   *
+   * \return false if there is no stream with this id
+   */
+  bool submit(StreamId id, const cv::Mat &I, double timestamp);
+
+  /**
+   * waits until no frame is queued or being tracked
+   */
+  void waitIdle();
+
+  /**
+   * \return the counters of a stream, all zero if there is no stream with
+   * this id
+   */
+  Stats stats(StreamId id) const;
+
+  inline int numWorkers() const { return static_cast<int>(workers_.size()); }
+
+private:
+  struct Frame {
+    cv::Mat image;
+    double timestamp;
+    int64_t index;
+    Clock::time_point submitted;
+    Clock::time_point deadline;
+  };
+
+  struct Stream {
+    StreamId id;
+    Clock::duration deadline;
+    Callback callback;
+    size_t max_queued;
+    std::deque<Frame> queue;
+    bool busy = false;           //< a worker is using the trackers
+    std::vector<std::unique_ptr<TrackerType>> trackers;
+    std::vector<cv::Mat> pyr;    //< frame pyramid shared by the trackers
+    int64_t next_index = 0;
+    FrameResult result;          //< results of the last frame, reused
+    Stats stats;
+    double latency_sum_ms = 0.0;
+    Clock::time_point first_submit;
+  };
+
+  /**
+   * takes the queued frame with the earliest deadline and marks its stream
+   * busy. Must hold mutex_
+   *
+   * \return the stream of the frame, nullptr if there is no frame to track
+   */
+  std::shared_ptr<Stream> NextFrame(Frame &frame);
+
+  /**
+   * tracks all the targets of the stream in the frame, into s.result
+   */
+  void TrackFrame(Stream &s, const Frame &frame);
+
+  /**
+   * waits until the stream is not busy and marks it busy. Must hold mutex_
+   * through lock
+   *
+   * \return nullptr if the stream was removed in the meantime
+   */
+  std::shared_ptr<Stream> Acquire(StreamId id, std::unique_lock<std::mutex> &lock);
+
+  void workerLoop();
+
+private:
+  Parameters params_;
+  std::map<StreamId, std::shared_ptr<Stream>> streams_;
+  std::vector<std::thread> workers_;
+  mutable std::mutex mutex_;           //< protects the streams and stop_
+  std::condition_variable work_cv_;    //< signaled when a frame is queued or a stream is released
+  std::condition_variable idle_cv_;    //< signaled when a worker is done with a frame
+  StreamId next_id_ = 0;
+  int num_busy_ = 0;                   //< frames being tracked
+  bool stop_ = false;
+};
+
+NAMESPACE_END
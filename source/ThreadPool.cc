@@ -0,0 +1,145 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/01 10:20
+ * @Description: ThreadPool
+ * @FilePath: Bitplanes/source/ThreadPool.cc
+ */
+#include "ThreadPool.h"
+#include <algorithm>
+
+NAMESPACE_BEGIN
+/**
+ * pool and queue of the worker running on this thread
+ */
+static thread_local const ThreadPool *t_pool = nullptr;
+static thread_local size_t t_queue = 0;
+
+ThreadPool::ThreadPool(int num_threads) {
+  if (num_threads <= 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int i = 0; i < num_threads; ++i)
+    queues_.emplace_back(new Queue);
+  for (int i = 0; i < num_threads; ++i)
+    workers_.emplace_back(&ThreadPool::workerLoop, this, static_cast<size_t>(i));
+}
+
+ThreadPool::~ThreadPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto &w : workers_)
+    w.join();
+}
+
+void ThreadPool::submit(Task task) {
+  // 1.工作线程提交到自己的队列，其它线程按顺序提交到共享队列
+  Queue &q = t_pool == this ? *queues_[t_queue] : shared_;
+  ++num_pending_;
+  {
+    std::lock_guard<std::mutex> lock(q.mutex);
+    q.tasks.push_back(std::move(task));
+    ++num_queued_;
+  }
+
+  // 2.唤醒一个空闲的工作线程，加锁避免工作线程检查条件后、等待前错过通知
+  std::lock_guard<std::mutex> lock(mutex_);
+  work_cv_.notify_one();
+}
+
+void ThreadPool::wait() {
+  // 调用线程也参与执行任务，直到所有任务完成
+  while (num_pending_ > 0) {
+    Task task;
+    if (take(task)) {
+      run(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return num_pending_ == 0 || num_queued_ > 0; });
+  }
+}
+
+bool ThreadPool::take(Task &task) {
+  // 工作线程先取自己队列中最新的任务，其次是共享队列中最早的任务，最后从其它工作线程窃取
+  if (t_pool == this)
+    return pop(t_queue, task) || popShared(task) || steal(t_queue, task);
+  return popShared(task) || steal(queues_.size(), task);
+}
+
+bool ThreadPool::pop(size_t i, Task &task) {
+  auto &q = *queues_[i];
+  std::lock_guard<std::mutex> lock(q.mutex);
+  if (q.tasks.empty())
+    return false;
+  task = std::move(q.tasks.back());
+  q.tasks.pop_back();
+  --num_queued_;
+  return true;
+}
+
+bool ThreadPool::popShared(Task &task) {
+  std::lock_guard<std::mutex> lock(shared_.mutex);
+  if (shared_.tasks.empty())
+    return false;
+  task = std::move(shared_.tasks.front());
+  shared_.tasks.pop_front();
+  --num_queued_;
+  return true;
+}
+
+bool ThreadPool::steal(size_t i, Task &task) {
+  const size_t n = queues_.size();
+  for (size_t k = 0; k < n; ++k) {
+    const size_t j = (i + 1 + k) % n;
+    if (j == i)
+      continue;
+    auto &q = *queues_[j];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty())
+      continue;
+    task = std::move(q.tasks.front());
+    q.tasks.pop_front();
+    --num_queued_;
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::run(Task &task) {
+  try {
+    task();
+  } catch (...) {
+  }
+  task = nullptr;
+
+  // 最后一个任务完成时唤醒等待的线程
+  if (--num_pending_ == 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_cv_.notify_all();
+  }
+}
+
+void ThreadPool::workerLoop(size_t i) {
+  t_pool = this;
+  t_queue = i;
+  for (;;) {
+    Task task;
+    if (take(task)) {
+      run(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_cv_.wait(lock, [this]() { return stop_ || num_queued_ > 0; });
+    if (stop_ && num_queued_ == 0)
+      return;
+  }
+}
+
+NAMESPACE_END
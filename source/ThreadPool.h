@@ -0,0 +1,101 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/01 10:05
+ * @Description: ThreadPool
+ * @FilePath: Bitplanes/source/ThreadPool.h
+ */
+#pragma once
+
+#include "API.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+NAMESPACE_BEGIN
+/**
+ * Work-stealing thread pool
+ *
+ * Tasks submitted from other threads go to a shared queue and start in the
+ * order they were submitted, e.g. the largest first. Tasks submitted from a
+ * worker go to its own queue, where it runs the most recent one first. A
+ * worker takes the tasks of its own queue, then the oldest task of the shared
+ * queue, and steals the oldest task of the other workers when both are empty
+ */
+class ThreadPool {
+public:
+  typedef std::function<void()> Task;
+
+  /**
+   * \param num_threads number of workers, <= 0 means one per hardware thread
+   */
+  explicit ThreadPool(int num_threads = 0);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * queues a task. Tasks must not throw, exceptions are discarded
+   */
+  void submit(Task task);
+
+  /**
+   * runs queued tasks on the calling thread until all the submitted tasks,
+   * including those they submit, are finished
+   */
+  void wait();
+
+  inline int numThreads() const { return static_cast<int>(workers_.size()); }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  /**
+   * takes the next task for the calling thread, see above
+   */
+  bool take(Task &task);
+
+  /**
+   * takes the most recent task of queue i
+   */
+  bool pop(size_t i, Task &task);
+
+  /**
+   * takes the oldest task of the shared queue
+   */
+  bool popShared(Task &task);
+
+  /**
+   * takes the oldest task of a queue other than i, i == queues_.size() for
+   * any queue
+   */
+  bool steal(size_t i, Task &task);
+
+  void run(Task &task);
+
+  void workerLoop(size_t i);
+
+private:
+  std::vector<std::unique_ptr<Queue>> queues_;   //< one per worker
+  Queue shared_;                                 //< tasks submitted from other threads, in order
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;                             //< protects stop_ and the waits
+  std::condition_variable work_cv_;              //< signaled when tasks are queued
+  std::condition_variable done_cv_;              //< signaled when all tasks are done
+  std::atomic<size_t> num_queued_{0};            //< tasks in the queues
+  std::atomic<size_t> num_pending_{0};           //< tasks submitted and not finished
+  bool stop_ = false;
+};
+
+NAMESPACE_END
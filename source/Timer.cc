@@ -23,4 +23,9 @@ auto Timer::elapsed() -> Milliseconds {
   auto t_now = std::chrono::high_resolution_clock::now();
   return std::chrono::duration_cast<Milliseconds>(t_now - start_time_);
 }
+
+auto Timer::elapsedMicroseconds() -> Microseconds {
+  auto t_now = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<Microseconds>(t_now - start_time_);
+}
 NAMESPACE_END
@@ -17,6 +17,7 @@ NAMESPACE_BEGIN
  */
 class Timer {
   typedef std::chrono::milliseconds Milliseconds;
+  typedef std::chrono::microseconds Microseconds;
 
 public:
   /**
@@ -40,6 +41,11 @@ public:
    */
   Milliseconds elapsed();
 
+  /**
+   * Same as elapsed() with microsecond resolution
+   */
+  Microseconds elapsedMicroseconds();
+
 protected:
   std::chrono::high_resolution_clock::time_point start_time_;
 };
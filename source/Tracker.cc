@@ -10,24 +10,167 @@
 #include "Timer.h"
 
 #include <Eigen/LU>
+#include <algorithm>
+#include <cmath>
+#include <new>
 
 NAMESPACE_BEGIN
-static cv::CLAHE *clahe() {
-  static cv::Ptr<cv::CLAHE> s_clahe = cv::createCLAHE(6.0, cv::Size(8, 8));
-  return s_clahe.get();
+/**
+ * returns an image of the given size stored in the arena
+ */
+static inline
+cv::Mat AllocateImage(Arena &arena, const cv::Size &size) {
+  return cv::Mat(size, CV_8UC1, arena.allocate<uint8_t>(size.area()));
+}
+
+/**
+ * returns a view of the top-left 'size' pixels of buf. buf only grows, so the
+ * view does not allocate once buf is large enough
+ */
+static inline
+cv::Mat ReserveView(cv::Mat &buf, const cv::Size &size, int type) {
+  if (buf.empty() || buf.type() != type || buf.cols < size.width || buf.rows < size.height)
+    buf.create(std::max(buf.rows, size.height), std::max(buf.cols, size.width), type);
+  return buf(cv::Rect(0, 0, size.width, size.height));
+}
+
+static inline
+Vector2f ProjectPoint(const Matrix33f &T, float x, float y) {
+  const Vector3f p = T * Vector3f(x, y, 1.0f);
+  return Vector2f(p[0] / p[2], p[1] / p[2]);
+}
+
+/**
+ * returns the corners of the bounding box transformed by T
+ */
+static inline
+std::array<Vector2f, 4> ProjectCorners(const cv::Rect &r, const Matrix33f &T) {
+  auto x1 = static_cast<float>(r.x);
+  auto y1 = static_cast<float>(r.y);
+  auto x2 = static_cast<float>(r.x + r.width);
+  auto y2 = static_cast<float>(r.y + r.height);
+
+  std::array<Vector2f, 4> ret;
+  ret[0] = ProjectPoint(T, x1, y1);
+  ret[1] = ProjectPoint(T, x2, y1);
+  ret[2] = ProjectPoint(T, x2, y2);
+  ret[3] = ProjectPoint(T, x1, y2);
+  return ret;
+}
+
+/**
+ * largest displacement of a bounding box corner between the two transforms
+ */
+static inline
+float CornerMotion(const cv::Rect &r, const Matrix33f &T0, const Matrix33f &T1) {
+  const auto x0 = ProjectCorners(r, T0), x1 = ProjectCorners(r, T1);
+  float ret = 0.0f;
+  for (size_t i = 0; i < x0.size(); ++i)
+    ret = std::max(ret, (x1[i] - x0[i]).norm());
+  return ret;
+}
+
+/**
+ * bounding rectangle of the bounding box transformed by T
+ */
+static inline
+cv::Rect ProjectedBoundingRect(const cv::Rect &r, const Matrix33f &T) {
+  const auto x = ProjectCorners(r, T);
+  float x_min = x[0][0], x_max = x[0][0], y_min = x[0][1], y_max = x[0][1];
+  for (size_t i = 1; i < x.size(); ++i) {
+    x_min = std::min(x_min, x[i][0]);
+    x_max = std::max(x_max, x[i][0]);
+    y_min = std::min(y_min, x[i][1]);
+    y_max = std::max(y_max, x[i][1]);
+  }
+  if (!std::isfinite(x_min + x_max + y_min + y_max))
+    return cv::Rect();
+
+  const auto x1 = static_cast<int>(std::floor(x_min)), y1 = static_cast<int>(std::floor(y_min));
+  return cv::Rect(x1, y1, static_cast<int>(std::ceil(x_max)) - x1, static_cast<int>(std::ceil(y_max)) - y1);
+}
+
+/**
+ * area of the bounding box transformed by T
+ */
+static inline
+float ProjectedArea(const cv::Rect &r, const Matrix33f &T) {
+  const auto x = ProjectCorners(r, T);
+  float a = 0.0f;
+  for (size_t i = 0; i < x.size(); ++i) {
+    const auto &p = x[i], &q = x[(i + 1) % x.size()];
+    a += p[0] * q[1] - q[0] * p[1];
+  }
+  return 0.5f * std::fabs(a);
+}
+
+/**
+ * largest change of scale between the template and its projection before the
+ * transform is considered degenerate
+ */
+static constexpr float MAX_SCALE_CHANGE = 16.0f;
+
+/**
+ * true if the bounding box transformed by T is not a plausible view of the
+ * template: non-finite, flipped or non-convex, or scaled too much
+ */
+static inline
+bool IsDegenerate(const cv::Rect &r, const Matrix33f &T) {
+  if (!T.allFinite())
+    return true;
+
+  const auto x = ProjectCorners(r, T);
+  for (size_t i = 0; i < x.size(); ++i) {
+    const Vector2f e0 = x[(i + 1) % x.size()] - x[i];
+    const Vector2f e1 = x[(i + 2) % x.size()] - x[(i + 1) % x.size()];
+    if (!(e0[0] * e1[1] - e0[1] * e1[0] > 0.0f))
+      return true;
+  }
+
+  const float s = ProjectedArea(r, T) / static_cast<float>(std::max(1, r.area()));
+  return !(s < sq(MAX_SCALE_CHANGE) && s * sq(MAX_SCALE_CHANGE) > 1.0f);
 }
 
 template<class M>
 Tracker<M>::Tracker(Parameters p)
-  : params_(p), cdata_(p.subsampling), T_(Matrix33f::Identity()), T_inv_(Matrix33f::Identity()),
-    interp_(cv::INTER_LINEAR) {}
+  : params_(p), cdata_(p.subsampling), filter_(p.sigma), clahe_(cv::createCLAHE(6.0, cv::Size(8, 8))),
+    T_(Matrix33f::Identity()),
+    T_inv_(Matrix33f::Identity()), residuals_(nullptr, 0), interp_(cv::INTER_LINEAR) {}
+
+template<class M>
+size_t Tracker<M>::BufferSize(const cv::Size &image_size, const cv::Rect &bbox, const cv::Mat &mask) const {
+  // 模板数据、残差、输入图像缓存与变换后的模板区域图像
+  const size_t n_valid = cdata_.NumPixels(bbox, mask);
+  return cdata_.BufferSize(bbox, mask) + Arena::Bytes<float>(8 * n_valid) +
+         Arena::Bytes<uint8_t>(image_size.area()) + Arena::Bytes<uint8_t>(bbox.area());
+}
+
+template<class M>
+void Tracker<M>::setTemplate(const cv::Mat &image, const cv::Rect &bbox, Arena *arena) {
+  setTemplate(image, bbox, cv::Mat(), arena);
+}
 
 template<class M>
-void Tracker<M>::setTemplate(const cv::Mat &image, const cv::Rect &bbox) {
-  // 1.设置模板图像，并进行高斯模糊
-  image.copyTo(I_);
-  clahe()->apply(I_, I_);
-  SmoothImage(I_, bbox);
+void Tracker<M>::setTemplate(const cv::Mat &image, const cv::Rect &bbox, const cv::Mat &mask, Arena *arena) {
+  assert(mask.empty() || (mask.type() == CV_8UC1 && mask.size() == bbox.size()));
+
+  // 0.外部内存池空间不足时使用自己的内存池
+  const size_t bytes = BufferSize(image.size(), bbox, mask);
+  if (!arena || arena->remaining() < bytes) {
+    arena_.reserve(bytes, params_.huge_pages);
+    arena = &arena_;
+  } else {
+    arena_.release();
+  }
+
+  // 1.设置模板图像，只对模板及LBP需要的1个像素边界进行高斯模糊
+  cv::Mat I0;
+  clahe_->apply(image, I0);
+  I_ = AllocateImage(*arena, image.size());
+  const cv::Rect roi = cv::Rect(bbox.x - 1, bbox.y - 1, bbox.width + 2, bbox.height + 2) & cv::Rect(0, 0, I0.cols, I0.rows);
+  cv::Mat I_roi = I_(roi);
+  SmoothImage(I0, roi, I_roi);
+  offset_ = cv::Point(0, 0);
 
   // 2.将矩阵设置为单位阵
   cdata_.getNormedCoordinate(bbox, T_, T_inv_);
@@ -35,23 +178,91 @@ void Tracker<M>::setTemplate(const cv::Mat &image, const cv::Rect &bbox) {
   // 3.保存ROI位置
   bbox_ = bbox;
 
-  // 4.设置采样数据：ROI对应LBP特征的梯度对应海塞矩阵
-  cdata_.set(I_, bbox, T_(0, 0), T_inv_(0, 2), T_inv_(1, 2));
+  // 4.设置采样数据：掩码内LBP特征的梯度对应海塞矩阵，以及分块的数据
+  cdata_.setTileSize(params_.tile_size);
+  cdata_.set(I_, bbox, *arena, T_(0, 0), T_inv_(0, 2), T_inv_(1, 2), mask);
+  ResetSolverState();
 
   // 5.对海塞矩阵进行LDLT分解
   solver_.compute(-cdata_.hessian());
+
+  // 6.按模板图像大小预留跟踪时的缓存，之后同样大小的输入图像不再分配内存
+  I_buf_ = I_;
+  filter_.reserve(image.size());
+  Iw_ = AllocateImage(*arena, bbox.size());
+  new(&residuals_) Residuals(arena->allocate<float>(8 * cdata_.pixels().size()), 8 * cdata_.pixels().size());
 }
 
 template<class M>
-Result Tracker<M>::Track(const cv::Mat &image, const Transform &T_init) {
-  // 1.保存图像，并进行高斯平滑
-  image.copyTo(I_);
-  SmoothImage(I_, bbox_);
+void Tracker<M>::shareTemplate(const Tracker &other) {
+  // 1.共享模板数据的视图，不复制数据。other可能丢弃了分块或有不可见的像素，解算器重新分解
+  params_ = other.params_;
+  bbox_ = other.bbox_;
+  T_ = other.T_;
+  T_inv_ = other.T_inv_;
+  interp_ = other.interp_;
+  filter_ = other.filter_;
+  cdata_.shareFrom(other.cdata_);
+  ResetSolverState();
+  solver_.compute(-cdata_.hessian());
 
-  // 2.将返回结果设置位初始化位姿矩阵
-  Result ret(T_init);
+  // 2.分配自己的跟踪缓存
+  const size_t n = 8 * cdata_.pixels().size();
+  arena_.reserve(Arena::Bytes<uint8_t>(other.I_buf_.size().area()) + Arena::Bytes<uint8_t>(bbox_.area()) +
+                 Arena::Bytes<float>(n), params_.huge_pages);
+  I_buf_ = AllocateImage(arena_, other.I_buf_.size());
+  I_ = I_buf_;
+  offset_ = cv::Point(0, 0);
+  Iw_ = AllocateImage(arena_, bbox_.size());
+  new(&residuals_) Residuals(arena_.allocate<float>(n), n);
+}
+
+template<class M>
+int Tracker<M>::updateTemplate(const cv::Mat &image, const cv::Rect &region) {
+  const cv::Rect r = region & bbox_;
+  if (r.area() <= 0)
+    return 0;
+
+  // 1.与setTemplate相同的预处理，高斯平滑只在更新区域及LBP需要的2个像素边界内进行
+  cv::Mat I0, Is;
+  clahe_->apply(image, I0);
+  const cv::Rect roi = cv::Rect(r.x - 2, r.y - 2, r.width + 4, r.height + 4) & cv::Rect(0, 0, I0.cols, I0.rows);
+  SmoothImage(I0, roi, Is);
+
+  // 2.更新区域内的模板数据与海塞矩阵，8x8的LDLT分解直接重新计算
+  const int n = cdata_.update(Is, roi.tl(), r);
+  if (n > 0) {
+    solver_.compute(-cdata_.hessian());
+    std::fill(tile_dropped_.begin(), tile_dropped_.end(), 0);
+    num_dropped_ = 0;
+    num_hidden_ = 0;
+  }
+  return n;
+}
+
+template<class M>
+Result Tracker<M>::Track(const cv::Mat &image, const Transform &T_init, float max_time_us,
+                         const cv::Point &origin) {
   Timer timer;
 
+  // 1.只对预测位置附近的区域进行高斯平滑，I_在输入图像中的位置为offset_
+  const cv::Rect extent(origin, image.size());
+  const cv::Rect roi = SearchRegion(T_init, extent);
+  I_ = ReserveView(I_buf_, roi.size(), CV_8UC1);
+  SmoothImage(image, roi - origin, I_);
+  offset_ = roi.tl();
+
+  // 输入图像边界处的平滑用到了外推的像素，与模板不一致，这些像素视为在图像外
+  const int r = filter_.radius();
+  const int x0 = roi.x == extent.x ? r : 0, y0 = roi.y == extent.y ? r : 0;
+  const int x1 = roi.br().x == extent.br().x ? roi.width - r : roi.width;
+  const int y1 = roi.br().y == extent.br().y ? roi.height - r : roi.height;
+  valid_ = cv::Rect(x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0));
+
+  // 2.将返回结果设置位初始化位姿矩阵，上一次跟踪丢弃的块重新参与解算
+  Result ret(T_init);
+  ResetTiles();
+
   // 3.获取梯度最大值
   auto g_norm = this->Linearize(I_, ret.T);
   const auto p_tol = this->params_.parameter_tolerance,
@@ -65,7 +276,7 @@ Result Tracker<M>::Track(const cv::Mat &image, const Transform &T_init) {
   if (verbose) {
     printf("\n                                        First-Order         Norm of \n"
            " Iteration  Func-count    Residual       optimality            step\n");
-    printf(" %5d       %5d   %13.6g    %12.3g\n", 0, 1, residuals_.squaredNorm(), g_norm);
+    printf(" %5d       %5d   %13.6g    %12.3g\n", 0, 1, sum_sq_, g_norm);
   }
 
   // 4.若初始位姿态满足误差要求
@@ -74,25 +285,43 @@ Result Tracker<M>::Track(const cv::Mat &image, const Transform &T_init) {
       printf("initial value is optimal %g < %g\n", g_norm, tol_opt * rel_factor);
     }
 
-    ret.final_ssd_error = residuals_.squaredNorm();
+    ret.final_ssd_error = sum_sq_;
+    ret.final_cost = Cost();
     ret.first_order_optimality = g_norm;
     ret.time_ms = static_cast<float>(timer.stop().count());
     ret.num_iterations = 1;
     ret.status = OptimizerStatus::FirstOrderOptimality;
+    ret.dropped_tiles = num_dropped_;
+    ret.visible_fraction = VisibleFraction();
+    ret.successful = ret.visible_fraction > 0.0f;
     return ret;
   }
 
-  // 5.循环迭代估算位姿
-  float old_sum_sq = std::numeric_limits<float>::max();
-  bool has_converged = false;
-  int it = 1;
+  // 5.记录目前最好的位姿，时间预算用完或发散时返回。按每个残差的代价比较，移出图像或丢弃块的位姿不会因此显得更好
+  Transform best_T = ret.T;
+  float best_sum_sq = sum_sq_, best_cost = Cost();
+  auto out_of_time = [&]() {
+    return max_time_us > 0.0f && static_cast<float>(timer.elapsedMicroseconds().count()) >= max_time_us;
+  };
+
+  // 6.循环迭代估算位姿
+  float old_sum_sq = std::numeric_limits<float>::max(), old_cost = best_cost;
+  bool has_converged = false, has_diverged = false;
+  int it = 1, num_increases = 0;
+  if (out_of_time()) {
+    ret.status = OptimizerStatus::TimeBudgetExceeded;
+    old_sum_sq = best_sum_sq;
+    has_converged = true;
+  }
   while (!has_converged && it++ < max_iterations) {
-    // 5.1 解算位姿
+    // 6.1 解算位姿
     const ParameterVector dp = solver_.solve(gradient_);
-    // 5.2 计算残差
-    const auto sum_sq = residuals_.squaredNorm();
+    // 6.2 计算残差
+    const auto sum_sq = sum_sq_;
+    const auto cost = Cost();
+    const auto dp_norm = dp.norm();
+    num_increases = sum_sq > old_sum_sq ? num_increases + 1 : 0;
     {
-      const auto dp_norm = dp.norm();
       const auto p_norm = MotionModelType::MatrixToParams(ret.T).norm();
 
       if (verbose) {
@@ -105,21 +334,91 @@ Result Tracker<M>::Track(const cv::Mat &image, const Transform &T_init) {
                                     sqrt_eps, it, max_iterations, verbose,
                                     ret.status);
       old_sum_sq = sum_sq;
+      old_cost = cost;
+    }
+
+    // 6.3 发散检测：代价连续增大，或步长过大
+    if (!has_converged && this->params_.abort_on_divergence) {
+      const auto max_increases = this->params_.max_cost_increases;
+      const auto max_step = this->params_.max_step_norm;
+      if (max_increases > 0 && num_increases >= max_increases) {
+        if (verbose) {
+          printf("Diverged: cost increased over %d iterations\n", num_increases);
+        }
+        has_diverged = true;
+      } else if (max_step > 0.0f && !(dp_norm <= max_step)) {
+        if (verbose) {
+          printf("Diverged: step is too large [%g > %g]\n", dp_norm, max_step);
+        }
+        has_diverged = true;
+      }
     }
 
-    // 5.3 迭代计算
-    const Transform Td = T_inv_ * MotionModelType::ParamsToMatrix(dp) * T_;
-    ret.T = Td * ret.T;
+    // 6.4 迭代计算，更新后的位姿退化也视为发散
+    if (!has_diverged) {
+      const Transform Td = T_inv_ * MotionModelType::ParamsToMatrix(dp) * T_;
+      ret.T = Td * ret.T;
+      if (!has_converged && this->params_.abort_on_divergence && IsDegenerate(bbox_, ret.T)) {
+        if (verbose) {
+          printf("Diverged: degenerate transform\n");
+        }
+        has_diverged = true;
+      }
+    }
+
+    if (has_diverged) {
+      ret.status = OptimizerStatus::Diverged;
+      ret.successful = false;
+      if (this->params_.revert_to_best) {
+        ret.T = best_T;
+        old_sum_sq = best_sum_sq;
+        old_cost = best_cost;
+      }
+      break;
+    }
 
     if (!has_converged) {
       g_norm = this->Linearize(I_, ret.T);
+
+      const auto new_cost = Cost();
+      if (new_cost < best_cost) {
+        best_T = ret.T;
+        best_sum_sq = sum_sq_;
+        best_cost = new_cost;
+      }
+
+      // 6.5 时间预算用完，返回目前最好的位姿
+      if (out_of_time()) {
+        if (verbose) {
+          printf("Time budget exceeded [%g us]\n", max_time_us);
+        }
+        ret.status = OptimizerStatus::TimeBudgetExceeded;
+        ret.T = best_T;
+        old_sum_sq = best_sum_sq;
+        old_cost = best_cost;
+        break;
+      }
+
+      // 6.6 代价超过上限时放弃，同样返回目前最好的位姿
+      if (cost_bound_ && new_cost > cost_bound_->load(std::memory_order_relaxed)) {
+        ret.status = OptimizerStatus::Cancelled;
+        ret.T = best_T;
+        old_sum_sq = best_sum_sq;
+        old_cost = best_cost;
+        break;
+      }
     }
   }
 
-  // 6.获取解算结果
+  // 7.获取解算结果，模板完全在图像外时跟踪失败
+  ret.dropped_tiles = num_dropped_;
+  ret.visible_fraction = VisibleFraction();
+  if (ret.visible_fraction <= 0.0f)
+    ret.successful = false;
   ret.time_ms = static_cast<float>(timer.stop().count());
   ret.num_iterations = it;
   ret.final_ssd_error = old_sum_sq;
+  ret.final_cost = old_cost;
   ret.first_order_optimality = g_norm;
   if (ret.status == OptimizerStatus::NotStarted) {
     ret.status = OptimizerStatus::MaxIterations;
@@ -137,26 +436,150 @@ Result Tracker<M>::Track(const cv::Mat &image, const Transform &T_init) {
 template<class M>
 inline
 float Tracker<M>::Linearize(const cv::Mat &I, const Transform &T) {
-  // 1.获取T作用于bbox_后，对应ROI区域，并将结果保存到Iw_中
-  cdata_.WarpImage(I, T, bbox_, Iw_, interp_, 0.0f);
+  // 1.获取T作用于bbox_后，对应ROI区域，并将结果保存到Iw_中，I_在输入图像中的位置为offset_
+  const bool inside = cdata_.WarpImage(I, T, bbox_, Iw_, interp_, 0.0f, warp_bounds_.data(), &valid_, offset_);
 
-  // 2.计算当前图像中对应位置LBP描述子残差
-  cdata_.ComputeResiduals(Iw_, residuals_);
+  // 2.模板部分移出图像时，剔除从图像外插值得到的像素
+  UpdateVisibility(inside);
+  const int *cols = num_hidden_ > 0 ? visible_cols_.data() : nullptr;
 
-  // 3.计算梯度：雅可比矩阵乘以残差
-  gradient_ = cdata_.jacobian().transpose() * residuals_;
+  // 3.计算当前图像中对应位置LBP描述子残差，同时计算梯度：雅可比矩阵乘以残差
+  if (cdata_.numTiles() == 1) {
+    sum_sq_ = cdata_.ComputeResidualsAndGradient(Iw_, residuals_, gradient_, cols);
+    num_residuals_ = 8 * (static_cast<int>(cdata_.pixels().size()) - num_hidden_);
+  } else {
+    // 分块计算，丢弃看起来被遮挡的块后累加其余块的梯度与残差
+    cdata_.ComputeTileResidualsAndGradients(Iw_, residuals_, tile_gradients_.data(), tile_sum_sq_.data(), cols);
+    DropOccludedTiles();
+    gradient_.setZero();
+    sum_sq_ = 0.0f;
+    num_residuals_ = 0;
+    for (int t = 0; t < cdata_.numTiles(); ++t) {
+      if (tile_dropped_[t])
+        continue;
+      gradient_ += tile_gradients_[t];
+      sum_sq_ += tile_sum_sq_[t];
+      num_residuals_ += 8 * (cdata_.tilePixels(t) - (num_hidden_ > 0 ? tile_hidden_pixels_[t] : 0));
+    }
+  }
 
   // 4.使用lpNorm<p>()方法，当模板参数p取特殊值Infinity时，得所有元素最大绝对值
   return gradient_.template lpNorm<Eigen::Infinity>();
 }
 
 template<class M>
-inline
-void Tracker<M>::SmoothImage(cv::Mat &I, const cv::Rect & /*roi*/) {
-  // 对输入图像进行高斯平滑
-  if (params_.sigma > 0) {
-    cv::GaussianBlur(I, I, cv::Size(), params_.sigma);
+void Tracker<M>::UpdateVisibility(bool inside) {
+  // 1.可见的列与上一次相同时，海塞矩阵的修正不变
+  int num_hidden = 0;
+  if (!inside) {
+    num_hidden = static_cast<int>(cdata_.pixels().size()) - cdata_.VisibleColumns(warp_bounds_.data(), cols_buf_.data());
+    if (num_hidden > 0 && num_hidden == num_hidden_ && cols_buf_ == visible_cols_)
+      return;
+  }
+  if (num_hidden == 0 && num_hidden_ == 0)
+    return;
+
+  // 2.计算每块不可见像素的海塞矩阵，重新分解
+  num_hidden_ = num_hidden;
+  if (num_hidden_ > 0) {
+    visible_cols_.swap(cols_buf_);
+    cdata_.HiddenHessians(visible_cols_.data(), tile_hidden_hessians_.data(), tile_hidden_pixels_.data());
+  }
+  UpdateSolver();
+}
+
+template<class M>
+void Tracker<M>::UpdateSolver() {
+  // 海塞矩阵减去被丢弃的块，以及其余块中不可见像素的贡献
+  Hessian H = cdata_.hessian();
+  for (int t = 0; t < cdata_.numTiles(); ++t) {
+    if (tile_dropped_[t])
+      H -= cdata_.tileHessian(t);
+    else if (num_hidden_ > 0)
+      H -= tile_hidden_hessians_[t];
+  }
+  solver_.compute(-H);
+}
+
+template<class M>
+void Tracker<M>::ResetSolverState() {
+  const int n = cdata_.numTiles();
+  tile_gradients_.resize(n);
+  tile_sum_sq_.resize(n);
+  tile_errors_.resize(2 * n);
+  tile_dropped_.assign(n, 0);
+  num_dropped_ = 0;
+  warp_bounds_.assign(2 * bbox_.height, 0);
+  visible_cols_.assign(2 * cdata_.gridRows(), 0);
+  cols_buf_.assign(2 * cdata_.gridRows(), 0);
+  tile_hidden_hessians_.assign(n, Hessian::Zero());
+  tile_hidden_pixels_.assign(n, 0);
+  num_hidden_ = 0;
+}
+
+template<class M>
+void Tracker<M>::DropOccludedTiles() {
+  const float threshold = params_.occlusion_threshold;
+  if (threshold <= 0.0f)
+    return;
+
+  // 1.每块可见像素中不匹配的LBP位所占比例，没有可见像素的块不计入中位数
+  const int n = cdata_.numTiles();
+  float *e = tile_errors_.data(), *sorted = e + n;
+  int m = 0;
+  for (int t = 0; t < n; ++t) {
+    const int pixels = cdata_.tilePixels(t) - (num_hidden_ > 0 ? tile_hidden_pixels_[t] : 0);
+    e[t] = tile_sum_sq_[t] / static_cast<float>(8 * std::max(1, pixels));
+    if (pixels > 0)
+      sorted[m++] = e[t];
   }
+  if (m == 0)
+    return;
+
+  // 2.超过阈值且超过中位数两倍的块视为被遮挡，因此最多丢弃一半的块。一次跟踪中丢弃后不再恢复
+  std::nth_element(sorted, sorted + m / 2, sorted + m);
+  const float limit = std::max(threshold, 2.0f * sorted[m / 2]);
+  bool changed = false;
+  for (int t = 0; t < n; ++t) {
+    if (!tile_dropped_[t] && e[t] > limit) {
+      tile_dropped_[t] = 1;
+      ++num_dropped_;
+      changed = true;
+    }
+  }
+  if (!changed)
+    return;
+
+  // 3.从海塞矩阵中减去被丢弃块的贡献，重新分解
+  UpdateSolver();
+}
+
+template<class M>
+void Tracker<M>::ResetTiles() {
+  if (num_dropped_ == 0)
+    return;
+  std::fill(tile_dropped_.begin(), tile_dropped_.end(), 0);
+  num_dropped_ = 0;
+  UpdateSolver();
+}
+
+template<class M>
+inline
+void Tracker<M>::SmoothImage(const cv::Mat &I, const cv::Rect &roi, cv::Mat &dst) {
+  // 对输入图像的ROI进行高斯平滑，ROI外的像素作为滤波边界
+  filter_.apply(I, roi, dst);
+}
+
+template<class M>
+cv::Rect Tracker<M>::SearchRegion(const Transform &T_init, const cv::Rect &extent) const {
+  if (params_.search_margin < 0.0f)
+    return extent;
+
+  // 预测位置外扩margin，另加LBP邻域与插值需要的2个像素
+  cv::Rect r = ProjectedBoundingRect(bbox_, T_init);
+  const int margin = static_cast<int>(std::ceil(params_.search_margin * static_cast<float>(std::max(r.width, r.height)))) + 2;
+  r = cv::Rect(r.x - margin, r.y - margin, r.width + 2 * margin, r.height + 2 * margin) & extent;
+  return r.area() > 0 ? r : extent;
 }
 
 template
@@ -185,53 +608,677 @@ MakeAlgorithmParametersPyramid(Parameters p) {
 }
 
 
+/**
+ * samples the mask of the template location src_box of a level at the
+ * template location dst_box of the next coarser level, nearest neighbor
+ */
+static void DownsampleMask(const cv::Mat &src, const cv::Rect &src_box, const cv::Rect &dst_box, cv::Mat &dst) {
+  dst.create(dst_box.size(), CV_8UC1);
+  for (int y = 0; y < dst.rows; ++y) {
+    const int ys = std::min(src.rows - 1, std::max(0, 2 * (y + dst_box.y) - src_box.y));
+    const auto *s_row = src.ptr<const uint8_t>(ys);
+    auto *d_row = dst.ptr<uint8_t>(y);
+    for (int x = 0; x < dst.cols; ++x)
+      d_row[x] = s_row[std::min(src.cols - 1, std::max(0, 2 * (x + dst_box.x) - src_box.x))];
+  }
+}
+
 template<class M>
-void PyramidTracker<M>::setTemplate(const cv::Mat &I, const cv::Rect &bbox) {
+void PyramidTracker<M>::BuildTemplate(const cv::Mat &I, const cv::Rect &bbox, const cv::Mat &mask,
+                                      TemplateData &data) {
   // 1.创建金字塔参数
   auto alg_params = MakeAlgorithmParametersPyramid(alg_params_);
 
-  // 2.拷贝传入图像
-  cv::Mat I0;
-  I.copyTo(I0);
-
-  // 3.创建跟踪器金字塔
-  pyramid_.clear();
+  // 2.创建跟踪器金字塔，预留空间避免复制
+  data.pyramid.clear();
+  data.pyramid.reserve(alg_params.size());
   for (size_t i = 0; i < alg_params.size(); ++i) {
-    pyramid_.push_back(Tracker(alg_params[i]));
+    data.pyramid.emplace_back(alg_params[i]);
+  }
+
+  // 3.计算各层模板位置与掩码，以及模板数据与缓存所需内存，一次性分配，已有的内存足够时复用
+  std::vector<cv::Size> sizes(data.pyramid.size(), I.size());
+  std::vector<cv::Rect> bboxes(data.pyramid.size(), bbox);
+  std::vector<cv::Mat> masks(data.pyramid.size(), mask);
+  size_t bytes = data.pyramid[0].BufferSize(sizes[0], bboxes[0], masks[0]);
+  for (size_t i = 1; i < data.pyramid.size(); ++i) {
+    sizes[i] = cv::Size((sizes[i - 1].width + 1) / 2, (sizes[i - 1].height + 1) / 2);
+    bboxes[i] = cv::Rect(bboxes[i - 1].x / 2, bboxes[i - 1].y / 2,
+                         bboxes[i - 1].width / 2, bboxes[i - 1].height / 2);
+    if (!mask.empty())
+      DownsampleMask(masks[i - 1], bboxes[i - 1], bboxes[i], masks[i]);
+    bytes += Arena::Bytes<uint8_t>(sizes[i].area()) + data.pyramid[i].BufferSize(sizes[i], bboxes[i], masks[i]);
+  }
+  data.arena.reserve(bytes, alg_params_.huge_pages);
+
+  // 4.构建图像金字塔，各层图像的缓存留给跟踪时使用
+  data.I_pyr_buf.assign(data.pyramid.size(), cv::Mat());
+  for (size_t i = 1; i < data.pyramid.size(); ++i) {
+    data.I_pyr_buf[i] = AllocateImage(data.arena, sizes[i]);
+    imgproc::PyrDown(i == 1 ? I : data.I_pyr_buf[i - 1], data.I_pyr_buf[i]);
   }
 
-  // 4.为金字塔每一层设置模板
-  pyramid_[0].setTemplate(I0, bbox);
-  cv::Rect bbox_copy(bbox);
-  for (size_t i = 1; i < pyramid_.size(); ++i) {
-    cv::pyrDown(I0, I0);
-    bbox_copy.x /= 2;
-    bbox_copy.y /= 2;
-    bbox_copy.width /= 2;
-    bbox_copy.height /= 2;
-    pyramid_[i].setTemplate(I0, bbox_copy);
+  // 5.从内存池中为每层划分各自连续的内存
+  std::vector<Arena> arenas;
+  arenas.reserve(data.pyramid.size());
+  for (size_t i = 0; i < data.pyramid.size(); ++i) {
+    const size_t n = data.pyramid[i].BufferSize(sizes[i], bboxes[i], masks[i]);
+    arenas.emplace_back(data.arena.allocate(n), n);
   }
 
-  // 5.将初始位姿设置位单位矩阵
+  // 6.各层模板相互独立：粗层在线程池中设置，第0层在当前线程中设置，其内部可以并行计算。
+  // 线程池跨模板复用，每次构建不再创建线程
+  auto set_level = [&](size_t i) {
+    data.pyramid[i].setTemplate(i == 0 ? I : data.I_pyr_buf[i], bboxes[i], masks[i], &arenas[i]);
+  };
+  const int num_coarse = static_cast<int>(data.pyramid.size()) - 1;
+  if (num_coarse > 0 && (!template_pool_ || template_pool_->numThreads() < num_coarse))
+    template_pool_.reset(new ThreadPool(num_coarse));
+  for (size_t i = 1; i < data.pyramid.size(); ++i)
+    template_pool_->submit([&set_level, i]() { set_level(i); });
+  set_level(0);
+  if (num_coarse > 0)
+    template_pool_->wait();
+  data.bbox = bbox;
+}
+
+template<class M>
+PyramidTracker<M>::~PyramidTracker() {
+  if (worker_.joinable())
+    worker_.join();
+  {
+    std::lock_guard<std::mutex> lock(refine_mutex_);
+    refine_stop_ = true;
+  }
+  refine_cv_.notify_all();
+  if (refine_thread_.joinable())
+    refine_thread_.join();
+}
+
+template<class M>
+void PyramidTracker<M>::ResetTemplateState() {
+  // 预留跟踪时的缓存，并将初始位姿设置位单位矩阵
+  I_pyr_.assign(data_.pyramid.size(), cv::Mat());
+  {
+    std::lock_guard<std::mutex> lock(refine_mutex_);
+    refined_frame_ = -1;
+  }
+  num_frames_ = 0;
+  deferred_update_ = false;
   T_init_.setIdentity();
+  last_motion_ = -1.0f;
+  T_key_.setIdentity();
+  workspaces_stale_ = true;
+  last_result_ = Result();
+  ref_samples_.clear();
+  time_ = 0.0;
+  if (predictor_) predictor_->reset();
 }
 
 template<class M>
-Result PyramidTracker<M>::Track(const cv::Mat &I, const Transform &T_init) {
-  float s = 1.0f / (1 << (pyramid_.size() - 1));
+void PyramidTracker<M>::setTemplate(const cv::Mat &I, const cv::Rect &bbox) {
+  setTemplate(I, bbox, cv::Mat());
+}
+
+template<class M>
+void PyramidTracker<M>::setTemplate(const cv::Mat &I, const cv::Rect &bbox, const cv::Mat &mask) {
+  // 1.放弃正在后台构建的模板与还未开始的细化
+  if (worker_.joinable())
+    worker_.join();
+  pending_ready_ = false;
+  CancelRefinement();
+
+  // 2.构建模板数据
+  BuildTemplate(I, bbox, mask, data_);
+  ResetTemplateState();
+}
+
+template<class M>
+void PyramidTracker<M>::setTemplate(const cv::Mat &I, const std::vector<cv::Rect> &rects) {
+  // 模板位置为所有矩形的外接矩形，掩码为各个矩形的并集，重叠的部分只跟踪一次
+  assert(!rects.empty());
+  cv::Rect bbox;
+  for (const auto &r : rects) {
+    assert(r.area() > 0);
+    bbox = bbox.area() > 0 ? (bbox | r) : r;
+  }
+  cv::Mat mask = cv::Mat::zeros(bbox.size(), CV_8UC1);
+  for (const auto &r : rects)
+    mask(r - bbox.tl()).setTo(255);
+  setTemplate(I, bbox, mask);
+}
+
+template<class M>
+void PyramidTracker<M>::setTemplateAsync(const cv::Mat &I, const cv::Rect &bbox) {
+  // 1.等待上一次后台构建结束，其结果被新的模板取代
+  if (worker_.joinable())
+    worker_.join();
+  pending_ready_ = false;
+
+  // 2.复制输入图像，调用者可以立即复用I
+  I.copyTo(pending_.image);
+
+  // 3.在工作线程中构建模板数据，跟踪继续使用当前模板
+  worker_ = std::thread([this, bbox]() {
+    BuildTemplate(pending_.image, bbox, cv::Mat(), pending_);
+    pending_ready_.store(true, std::memory_order_release);
+  });
+}
+
+template<class M>
+int PyramidTracker<M>::updateTemplate(const cv::Mat &I, const cv::Rect &region) {
+  // 与BuildTemplate相同的方式逐层下采样，更新区域按层缩小并向外取整
+  cv::Mat levels[2];
+  cv::Rect r = region;
+  int ret = 0;
+  waitForRefinement();
+  for (size_t i = 0; i < data_.pyramid.size(); ++i) {
+    const cv::Mat &level = i == 0 ? I : levels[i % 2];
+    const int n = data_.pyramid[i].updateTemplate(level, r);
+    if (i == 0)
+      ret = n;
+
+    if (i + 1 < data_.pyramid.size()) {
+      imgproc::PyrDown(level, levels[(i + 1) % 2]);
+      const int x1 = r.x >> 1, y1 = r.y >> 1;
+      r = cv::Rect(x1, y1, ((r.x + r.width + 1) >> 1) - x1, ((r.y + r.height + 1) >> 1) - y1);
+    }
+  }
+  workspaces_stale_ = true;
+  return ret;
+}
+
+template<class M>
+void PyramidTracker<M>::waitForTemplate() {
+  if (worker_.joinable())
+    worker_.join();
+  SwapTemplate();
+}
+
+template<class M>
+bool PyramidTracker<M>::SwapTemplate() {
+  if (!pending_ready_.load(std::memory_order_acquire))
+    return false;
+
+  // 交换当前模板与新模板，旧模板的内存留给下一次setTemplateAsync复用
+  if (worker_.joinable())
+    worker_.join();
+  pending_ready_ = false;
+  CancelRefinement();
+  std::swap(data_, pending_);
+  ResetTemplateState();
+  return true;
+}
+
+template<class M>
+void PyramidTracker<M>::SelectLevels(const Transform &T_init, int &finest, int &coarsest) const {
+  const int max_level = (int) data_.pyramid.size() - 1;
+  finest = 0;
+  coarsest = max_level;
+
+  // 1.模板在图像中每缩小一半，最细层上移一层
+  const float scale = std::sqrt(ProjectedArea(data_.bbox, T_init) / static_cast<float>(std::max(1, data_.bbox.area())));
+  if (!std::isfinite(scale))
+    return;
+  while (finest < max_level && scale * static_cast<float>(2 << finest) <= 1.0f)
+    ++finest;
+
+  // 2.运动未知时使用所有粗层
+  if (last_motion_ < 0.0f)
+    return;
+
+  // 3.预测运动与上一帧运动取较大值，选择足以覆盖该运动的最粗层
+  const float motion = std::max(CornerMotion(data_.bbox, T_init_, T_init), last_motion_);
+  if (!std::isfinite(motion))
+    return;
+  coarsest = finest;
+  while (coarsest < max_level && motion > alg_params_.level_motion_pixels * static_cast<float>(1 << coarsest))
+    ++coarsest;
+}
+
+/**
+ * number of samples per side of the grid used to detect unchanged frames
+ */
+static constexpr int CHANGE_GRID_SIZE = 32;
+
+template<class M>
+bool PyramidTracker<M>::SampleFrame(const cv::Mat &I, std::vector<uint8_t> &samples) const {
+  const cv::Rect roi = ProjectedBoundingRect(data_.bbox, T_init_) & cv::Rect(0, 0, I.cols, I.rows);
+  if (roi.width < CHANGE_GRID_SIZE || roi.height < CHANGE_GRID_SIZE)
+    return false;
+
+  // 在ROI中心均匀分布的网格上采样
+  const int n = CHANGE_GRID_SIZE;
+  samples.resize(n * n);
+  for (int j = 0; j < n; ++j) {
+    const auto *row = I.ptr<const uint8_t>(roi.y + ((2 * j + 1) * roi.height) / (2 * n));
+    for (int i = 0; i < n; ++i)
+      samples[j * n + i] = row[roi.x + ((2 * i + 1) * roi.width) / (2 * n)];
+  }
+  return true;
+}
+
+template<class M>
+bool PyramidTracker<M>::IsFrameUnchanged(const cv::Mat &I) {
+  if (ref_samples_.empty() || !SampleFrame(I, samples_) || samples_.size() != ref_samples_.size())
+    return false;
+
+  // 与上一次跟踪帧的平均绝对差
+  int sad = 0;
+  for (size_t i = 0; i < samples_.size(); ++i)
+    sad += std::abs(static_cast<int>(samples_[i]) - static_cast<int>(ref_samples_[i]));
+  return static_cast<float>(sad) < alg_params_.unchanged_frame_threshold * static_cast<float>(samples_.size());
+}
+
+template<class M>
+cv::Rect PyramidTracker<M>::PyramidRegion(const Transform &T_init, const cv::Size &size, int coarsest) const {
+  const cv::Rect full(0, 0, size.width, size.height);
+  if (alg_params_.search_margin < 0.0f)
+    return full;
+
+  // 1.预测位置外扩margin，另加每层金字塔下采样与高斯平滑的边界
+  const int align = 1 << coarsest;
+  cv::Rect r = ProjectedBoundingRect(data_.bbox, T_init);
+  const int margin = static_cast<int>(std::ceil(alg_params_.search_margin * static_cast<float>(std::max(r.width, r.height))))
+                     + 8 * align;
+  r = cv::Rect(r.x - margin, r.y - margin, r.width + 2 * margin, r.height + 2 * margin) & full;
+  if (r.area() <= 0)
+    return full;
+
+  // 2.起点对齐到最粗层的整数像素，使各层坐标为整数倍关系
+  const int x1 = r.x & ~(align - 1), y1 = r.y & ~(align - 1);
+  return cv::Rect(x1, y1, r.x + r.width - x1, r.y + r.height - y1);
+}
+
+template<class M>
+void PyramidTracker<M>::BeginFrame() {
+  // 后台构建的模板已完成时切换到新模板，之后本帧的预测与跟踪都使用该模板
+  SwapTemplate();
+  ApplyRefinement();
+}
+
+template<class M>
+typename PyramidTracker<M>::Transform PyramidTracker<M>::PredictPose(double timestamp) {
+  // 由运动模型预测当前帧位姿，没有预测器时使用上一帧位姿
+  BeginFrame();
+  return predictor_ ? predictor_->predict(timestamp) : T_init_;
+}
+
+template<class M>
+Result PyramidTracker<M>::Track(const cv::Mat &I, double timestamp) {
+  const Transform T_init = PredictPose(timestamp);
+  return DoTrack(I, nullptr, T_init, false, timestamp);
+}
+
+template<class M>
+Result PyramidTracker<M>::Track(const std::vector<cv::Mat> &pyr, double timestamp) {
+  const Transform T_init = PredictPose(timestamp);
+  return DoTrack(pyr[0], &pyr, T_init, false, timestamp);
+}
+
+template<class M>
+Result PyramidTracker<M>::TrackCoarse(const cv::Mat &I, double timestamp, RefineCallback on_refined) {
+  const Transform T_init = PredictPose(timestamp);
+  return DoTrack(I, nullptr, T_init, false, timestamp, &on_refined);
+}
+
+template<class M>
+Result PyramidTracker<M>::TrackCoarse(const std::vector<cv::Mat> &pyr, double timestamp,
+                                      RefineCallback on_refined) {
+  const Transform T_init = PredictPose(timestamp);
+  return DoTrack(pyr[0], &pyr, T_init, false, timestamp, &on_refined);
+}
+
+template<class M>
+void PyramidTracker<M>::waitForRefinement() {
+  std::unique_lock<std::mutex> lock(refine_mutex_);
+  refine_cv_.wait(lock, [this]() { return !refine_queued_ && !refining_; });
+}
+
+template<class M>
+bool PyramidTracker<M>::refinedResult(Result &r, double &timestamp) const {
+  std::lock_guard<std::mutex> lock(refine_mutex_);
+  if (refined_frame_ < 0)
+    return false;
+
+  r = refined_;
+  timestamp = refined_time_;
+  return true;
+}
+
+template<class M>
+void PyramidTracker<M>::QueueRefinement(Refinement &&job, const cv::Mat &image, const cv::Size &frame_size) {
+  {
+    std::lock_guard<std::mutex> lock(refine_mutex_);
+    if (!refine_thread_.joinable())
+      refine_thread_ = std::thread(&PyramidTracker::refineLoop, this);
+
+    // 1.调用者会复用输入图像，将第0层复制到正在细化的帧没有使用的缓存中，缓存按整帧大小预留
+    const int b = refine_running_buf_ == 0 ? 1 : 0;
+    ReserveView(refine_buf_[b], frame_size, CV_8UC1);
+    job.image = refine_buf_[b](cv::Rect(0, 0, image.cols, image.rows));
+    image.copyTo(job.image);
+    job.buffer = b;
+
+    // 2.还未开始的细化被本帧取代
+    refine_job_ = std::move(job);
+    refine_queued_ = true;
+  }
+  refine_cv_.notify_all();
+}
+
+template<class M>
+void PyramidTracker<M>::CancelRefinement() {
+  std::unique_lock<std::mutex> lock(refine_mutex_);
+  if (refine_queued_) {
+    refine_queued_ = false;
+    refine_job_ = Refinement();
+  }
+  refine_cv_.wait(lock, [this]() { return !refining_; });
+}
+
+template<class M>
+void PyramidTracker<M>::ApplyRefinement() {
+  if (!deferred_update_)
+    return;
+  deferred_update_ = false;
+
+  // 1.上一帧已细化完成时，以细化后的位姿作为上一帧的位姿
+  {
+    std::lock_guard<std::mutex> lock(refine_mutex_);
+    if (refined_frame_ == num_frames_ - 1 && refined_.status != OptimizerStatus::Diverged) {
+      T_init_ = refined_.T;
+      T_key_ = refined_.T;
+    }
+  }
+
+  // 2.运动预测器使用上一帧最终的位姿
+  if (predictor_) predictor_->update(T_init_, time_);
+}
+
+template<class M>
+void PyramidTracker<M>::refineLoop() {
+  std::unique_lock<std::mutex> lock(refine_mutex_);
+  for (;;) {
+    refine_cv_.wait(lock, [this]() { return refine_stop_ || refine_queued_; });
+    if (refine_stop_)
+      return;
+
+    // 1.取出排队的帧，在锁外从粗层位姿开始跟踪第0层
+    Refinement job = std::move(refine_job_);
+    refine_job_ = Refinement();
+    refine_queued_ = false;
+    refining_ = true;
+    refine_running_buf_ = job.buffer;
+    lock.unlock();
+    const Result r = data_.pyramid[0].Track(job.image, job.T, job.max_time_us, job.origin);
+    job.image.release();
+
+    // 2.发布细化结果，回调返回后才算细化完成
+    lock.lock();
+    refined_ = r;
+    refined_frame_ = job.frame;
+    refined_time_ = job.timestamp;
+    lock.unlock();
+    if (job.callback)
+      job.callback(r, job.timestamp);
+    lock.lock();
+    refining_ = false;
+    refine_running_buf_ = -1;
+    refine_cv_.notify_all();
+  }
+}
+
+/**
+ * smallest share of the time budget given to a level. Tracker::Track takes 0
+ * as no budget, a level without template pixels must not get it
+ */
+static constexpr float MIN_LEVEL_TIME_US = 1.0f;
+
+/**
+ * a hypothesis is cancelled once its cost exceeds the cost of a converged one
+ * by this factor. The cost of the first iterations is above the converged cost
+ * even in the right basin, a margin keeps those hypotheses running
+ */
+static constexpr float COST_BOUND_FACTOR = 2.0f;
+
+template<class M>
+Result PyramidTracker<M>::TrackLevels(typename EigenStdVector<Tracker>::type &levels, const Transform &T_init,
+                                      int finest, int coarsest, const cv::Rect &roi, Timer timer, int *last_level) {
+  // 1.由粗到细逐层跟踪，level为ret.T所在的层
+  float s = 1.0f / static_cast<float>(1 << coarsest);
   Result ret(MotionModelType::Scale(T_init, s));
+  const float max_time_us = alg_params_.max_time_us;
+  int level = coarsest, num_levels = 0;
+  for (;;) {
+    // 1.1 将剩余时间按模板像素数分配给剩余的层。时间已用完时最粗层也至少线性化一次
+    float level_time_us = 0.0f;
+    if (max_time_us > 0.0f) {
+      const float remaining = max_time_us - static_cast<float>(timer.elapsedMicroseconds().count());
+      size_t n_total = 0;
+      for (int i = finest; i <= level; ++i)
+        n_total += levels[i].channelData().pixels().size();
+      const size_t n_level = levels[level].channelData().pixels().size();
+      level_time_us = std::max(MIN_LEVEL_TIME_US,
+                               remaining * static_cast<float>(n_level) / static_cast<float>(std::max<size_t>(1, n_total)));
+    }
+
+    // 1.2 跟踪当前层，发散、被取消或时间用完时跳过剩余的细层，level保持为最后跟踪的层
+    const cv::Point origin(roi.x >> level, roi.y >> level);
+    ret = levels[level].Track(I_pyr_[level], ret.T, level_time_us, origin);
+    ++num_levels;
+    if (level == finest || ret.status == OptimizerStatus::Diverged || ret.status == OptimizerStatus::Cancelled ||
+        ret.status == OptimizerStatus::TimeBudgetExceeded)
+      break;
+    if (max_time_us > 0.0f && static_cast<float>(timer.elapsedMicroseconds().count()) >= max_time_us) {
+      ret.status = OptimizerStatus::TimeBudgetExceeded;
+      break;
+    }
+    ret.T = MotionModelType::Scale(ret.T, 2.0);
+    --level;
+  }
+
+  // 2.最后跟踪的层不是第0层时，将位姿变换回第0层坐标
+  if (level != 0)
+    ret.T = MotionModelType::Scale(ret.T, static_cast<float>(1 << level));
+  ret.level = level;
+  ret.num_levels = num_levels;
+  if (last_level)
+    *last_level = level;
+  return ret;
+}
+
+template<class M>
+void PyramidTracker<M>::SelectHypotheses(const Transform &T_init) {
+  // 预测位姿、上一帧位姿、上一次未丢失的位姿与模板位姿，角点位移小于1个像素的视为重复
+  hypotheses_.clear();
+  hypotheses_.push_back(T_init);
+  const Transform candidates[] = {T_init_, T_key_, Transform::Identity()};
+  for (const auto &T : candidates) {
+    if (static_cast<int>(hypotheses_.size()) >= alg_params_.num_hypotheses)
+      break;
+
+    bool duplicate = false;
+    for (const auto &h : hypotheses_)
+      duplicate = duplicate || CornerMotion(data_.bbox, h, T) < 1.0f;
+    if (!duplicate)
+      hypotheses_.push_back(T);
+  }
+}
+
+/**
+ * true if the optimizer stopped because it converged
+ */
+static inline bool IsConverged(OptimizerStatus status) {
+  return status == OptimizerStatus::FirstOrderOptimality || status == OptimizerStatus::SmallRelativeReduction ||
+         status == OptimizerStatus::SmallAbsError || status == OptimizerStatus::SmallParameterUpdate ||
+         status == OptimizerStatus::SmallAbsParameters;
+}
+
+template<class M>
+Result PyramidTracker<M>::TrackHypotheses(int finest, int coarsest, const cv::Rect &roi, const Timer &timer) {
+  const size_t n = hypotheses_.size();
+
+  // 1.模板变化后重建各初始位姿的工作区：共享模板数据，只分配跟踪缓存。第0层可能正在细化，先等待其完成
+  if (workspaces_stale_ || workspaces_.size() + 1 < n) {
+    waitForRefinement();
+    workspaces_.resize(std::max(workspaces_.size(), n - 1));
+    for (auto &ws : workspaces_) {
+      ws.clear();
+      ws.reserve(data_.pyramid.size());
+      for (const auto &level : data_.pyramid) {
+        ws.emplace_back();
+        ws.back().shareTemplate(level);
+      }
+    }
+    workspaces_stale_ = false;
+  }
+  if (!pool_ || pool_->numThreads() + 1 < alg_params_.num_hypotheses)
+    pool_.reset(new ThreadPool(alg_params_.num_hypotheses - 1));
 
-  std::vector<cv::Mat> I_pyr(pyramid_.size());
-  I.copyTo(I_pyr[0]);
-  for (size_t i = 1; i < I_pyr.size(); ++i)
-    cv::pyrDown(I_pyr[i - 1], I_pyr[i]);
+  // 2.只在最细层比较每个残差的代价，收敛的初始位姿将代价上限降低到自己代价的 COST_BOUND_FACTOR 倍
+  cost_bound_ = std::numeric_limits<float>::max();
+  auto set_bound = [&](typename EigenStdVector<Tracker>::type &levels) {
+    for (int i = finest; i <= coarsest; ++i)
+      levels[i].setCostBound(i == finest ? &cost_bound_ : nullptr);
+  };
+  auto run = [this, finest, coarsest, &roi, &timer](typename EigenStdVector<Tracker>::type &levels, size_t h) {
+    hyp_results_[h] = TrackLevels(levels, hypotheses_[h], finest, coarsest, roi, timer, &hyp_levels_[h]);
+    if (hyp_levels_[h] != finest || !IsConverged(hyp_results_[h].status))
+      return;
+    const float new_bound = COST_BOUND_FACTOR * hyp_results_[h].final_cost;
+    float bound = cost_bound_.load();
+    while (new_bound < bound && !cost_bound_.compare_exchange_weak(bound, new_bound)) {}
+  };
 
-  for (int i = (int) pyramid_.size() - 1; i >= 0; --i) {
-    ret = pyramid_[i].Track(I_pyr[i], ret.T);
-    if (i != 0) ret.T = MotionModelType::Scale(ret.T, 2.0);
+  // 3.其余初始位姿在线程池中跟踪，预测位姿在当前线程中跟踪
+  hyp_results_.resize(n);
+  hyp_levels_.resize(n);
+  for (size_t h = 1; h < n; ++h) {
+    set_bound(workspaces_[h - 1]);
+    pool_->submit([&run, this, h]() { run(workspaces_[h - 1], h); });
+  }
+  set_bound(data_.pyramid);
+  run(data_.pyramid, 0);
+  pool_->wait();
+  data_.pyramid[finest].setCostBound(nullptr);
+
+  // 4.在最细层完成、未发散也未被放弃的结果中选择代价最小的，都不满足时返回预测位姿的结果
+  size_t best = 0;
+  float best_cost = std::numeric_limits<float>::max();
+  for (size_t h = 0; h < n; ++h) {
+    const Result &r = hyp_results_[h];
+    if (hyp_levels_[h] != finest || r.status == OptimizerStatus::Diverged || r.status == OptimizerStatus::Cancelled)
+      continue;
+    if (r.final_cost < best_cost) {
+      best = h;
+      best_cost = r.final_cost;
+    }
   }
+  return hyp_results_[best];
+}
+
+template<class M>
+Result PyramidTracker<M>::DoTrack(const cv::Mat &I, const std::vector<cv::Mat> *frame_pyr,
+                                  const Transform &T_init, bool pose_given, double timestamp,
+                                  const RefineCallback *on_refined) {
+  Timer timer;
 
+  // 0.帧内容与上一次跟踪帧相比没有变化时，直接返回上一次的结果；调用者给出了不同于上一帧的位姿时仍然跟踪
+  const bool detect_change = alg_params_.unchanged_frame_threshold > 0.0f;
+  if (detect_change && (!pose_given || T_init == T_init_) && IsFrameUnchanged(I)) {
+    Result ret(last_result_);
+    ret.status = OptimizerStatus::FrameUnchanged;
+    ret.num_iterations = 0;
+    ret.num_levels = 0;
+    ret.time_ms = static_cast<float>(timer.stop().count());
+
+    last_motion_ = 0.0f;
+    time_ = timestamp;
+    if (predictor_) predictor_->update(T_init_, timestamp);
+    return ret;
+  }
+
+  // 1.选择本帧需要运行的金字塔层与初始位姿
+  int finest = 0, coarsest = (int) data_.pyramid.size() - 1;
+  if (alg_params_.adaptive_levels)
+    SelectLevels(T_init, finest, coarsest);
+  SelectHypotheses(T_init);
+
+  // 1.1 两种速率跟踪时只跟踪到第1层，第0层交给细化线程；否则第0层须等细化线程用完
+  const bool refine = on_refined && finest == 0 && coarsest > 0;
+  if (refine)
+    finest = 1;
+  else if (finest == 0)
+    waitForRefinement();
+
+  // 2.只构建用到的图像金字塔层，并且只在各初始位置附近构建；已给出金字塔时直接使用
+  cv::Rect roi(0, 0, I.cols, I.rows);
+  if (frame_pyr) {
+    assert((int) frame_pyr->size() > coarsest);
+    for (int i = 0; i <= coarsest; ++i)
+      I_pyr_[i] = (*frame_pyr)[i];
+  } else {
+    roi = PyramidRegion(T_init, I.size(), coarsest);
+    for (size_t h = 1; h < hypotheses_.size(); ++h)
+      roi |= PyramidRegion(hypotheses_[h], I.size(), coarsest);
+    I_pyr_[0] = I(roi);
+    for (int i = 1; i <= coarsest; ++i) {
+      const cv::Size size((I_pyr_[i - 1].cols + 1) / 2, (I_pyr_[i - 1].rows + 1) / 2);
+      I_pyr_[i] = ReserveView(data_.I_pyr_buf[i], size, CV_8UC1);
+      imgproc::PyrDown(I_pyr_[i - 1], I_pyr_[i]);
+    }
+  }
+
+  // 3.由粗到细逐层跟踪，有多个初始位姿时并行跟踪并选择代价最小的结果
+  Result ret = hypotheses_.size() > 1 ?
+               TrackHypotheses(finest, coarsest, roi, timer) :
+               TrackLevels(data_.pyramid, T_init, finest, coarsest, roi, timer, nullptr);
+
+  // 3.1 粗层收敛后在细化线程中从粗层位姿开始跟踪第0层，时间预算为本帧剩余的预算
+  const float max_time_us = alg_params_.max_time_us;
+  const float remaining_us = max_time_us - static_cast<float>(timer.elapsedMicroseconds().count());
+  const bool queued = refine && ret.level == finest && ret.status != OptimizerStatus::Diverged &&
+                      ret.status != OptimizerStatus::Cancelled && (max_time_us <= 0.0f || remaining_us > 0.0f);
+  if (queued) {
+    Refinement job;
+    job.image = I_pyr_[0];
+    job.origin = roi.tl();
+    job.T = ret.T;
+    job.timestamp = timestamp;
+    job.max_time_us = max_time_us > 0.0f ? remaining_us : 0.0f;
+    job.frame = num_frames_;
+    job.callback = *on_refined;
+    QueueRefinement(std::move(job), I_pyr_[0], I.size());
+  }
+  ++num_frames_;
+  I_pyr_[0].release();
+  if (frame_pyr) {
+    for (int i = 1; i <= coarsest; ++i)
+      I_pyr_[i].release();
+  }
+
+  // 4.更新运动历史，发散的帧不参与运动预测
+  if (ret.status == OptimizerStatus::Diverged) {
+    last_motion_ = -1.0f;
+    if (predictor_) predictor_->reset();
+  } else {
+    last_motion_ = CornerMotion(data_.bbox, T_init_, ret.T);
+    T_key_ = ret.T;
+    if (queued)
+      deferred_update_ = true;
+    else if (predictor_)
+      predictor_->update(ret.T, timestamp);
+  }
   T_init_ = ret.T;
+  time_ = timestamp;
+
+  // 5.保存本帧在新位姿处的采样，用于检测下一帧是否变化
+  if (detect_change) {
+    last_result_ = ret;
+    if (ret.status == OptimizerStatus::Diverged || !SampleFrame(I, ref_samples_))
+      ref_samples_.clear();
+  }
   return ret;
 }
 
@@ -12,15 +12,35 @@
 #include "Parameters.h"
 #include "MotionModel.h"
 #include "ChannelDataSampler.h"
+#include "MotionPredictor.h"
+#include "Filter.h"
+#include "Arena.h"
+#include "ThreadPool.h"
+#include "Timer.h"
 
 #include <opencv2/opencv.hpp>
 #include <limits>
 #include <fstream>
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include <Eigen/Cholesky>
 
 NAMESPACE_BEGIN
+/**
+ * Single level tracker
+ *
+ * Thread safety: a Tracker holds all of its state, including the CLAHE and
+ * the smoothing buffers, so distinct instances can be used concurrently from
+ * different threads. One instance must not be used from several threads at
+ * once. The images given to setTemplate and Track are only read and can be
+ * shared between threads
+ */
 template<class M>
 class Tracker {
 public:
@@ -33,9 +53,11 @@ public:
 
   typedef typename Eigen::LDLT<Hessian> Solver;
   typedef ChannelDataSampler<M> ChannelDataType;
+  typedef typename ChannelDataType::Residuals Residuals;
 
 public:
   explicit Tracker(Parameters p = Parameters());
+  Tracker(Tracker &&) = default;
   ~Tracker() = default;
 
   /**
@@ -43,8 +65,51 @@ public:
    *
    * \param image the template image (I_0)
    * \param bbox  location of the template in image
+   * \param arena memory for the template data and the tracking buffers. If it
+   * is nullptr or has less than BufferSize() bytes remaining, the tracker uses
+   * its own arena
    */
-  void setTemplate(const cv::Mat &image, const cv::Rect &bbox);
+  void setTemplate(const cv::Mat &image, const cv::Rect &bbox, Arena *arena = nullptr);
+
+  /**
+   * Sets a template of arbitrary shape: only the pixels of bbox where mask is
+   * non zero are tracked and stored, all of them under the same transform
+   *
+   * \param mask CV_8UC1 of the size of bbox, empty for the whole bbox
+   */
+  void setTemplate(const cv::Mat &image, const cv::Rect &bbox, const cv::Mat &mask, Arena *arena = nullptr);
+
+  /**
+   * updates part of the template from a new image of the template, e.g. after
+   * a change of lighting or appearance. Only the template pixels inside region
+   * are re-sampled, the hessian is updated with their change
+   *
+   * \param image the new template image, same size as the one of setTemplate
+   * \param region region of the image to update
+   * \return the number of updated template pixels
+   */
+  int updateTemplate(const cv::Mat &image, const cv::Rect &region);
+
+  /**
+   * makes this tracker a second workspace of the template of other, e.g. to
+   * track several initializations concurrently. The template data is shared
+   * and only read, only the tracking buffers are allocated. other must not
+   * change its template while this tracker uses it
+   */
+  void shareTemplate(const Tracker &other);
+
+  /**
+   * sets a bound that stops Track, with the status OptimizerStatus::Cancelled,
+   * once the cost, see Result::final_cost, exceeds it. It may change while Track
+   * runs. nullptr to disable
+   */
+  inline void setCostBound(const std::atomic<float> *bound) { cost_bound_ = bound; }
+
+  /**
+   * \return bytes of the arena used by setTemplate for an image of the given
+   * size and template location and mask
+   */
+  size_t BufferSize(const cv::Size &image_size, const cv::Rect &bbox, const cv::Mat &mask = cv::Mat()) const;
 
   /**
    * Tracks the template that was set during the call setTemplate
@@ -52,7 +117,26 @@ public:
    * \param image the input image (I_1)
    * \param T_init initialization of the transform
    */
-  Result Track(const cv::Mat &image, const Transform &T_init = Transform::Identity());
+  Result Track(const cv::Mat &image, const Transform &T_init = Transform::Identity()) {
+    return Track(image, T_init, params_.max_time_us);
+  }
+
+  /**
+   * Tracks the template within a time budget
+   *
+   * \param image the input image (I_1), or a part of it
+   * \param T_init initialization of the transform
+   * \param max_time_us time budget in microseconds, <= 0 means no budget
+   * \param origin location of image in the input image when it is only a part
+   * of it
+   */
+  Result Track(const cv::Mat &image, const Transform &T_init, float max_time_us,
+               const cv::Point &origin = cv::Point(0, 0));
+
+  /**
+   * \return the template data
+   */
+  inline const ChannelDataType &channelData() const { return cdata_; }
 
 protected:
   /**
@@ -60,13 +144,80 @@ protected:
    *  - warp the image
    *  - re-compute the multi-channel descriptors
    *  - compute the cost function gradient (J^T * error)
+   *
+   * The sum of squared residuals is kept in sum_sq_. With tiles, only the
+   * tiles that are not dropped contribute to both. Template pixels warped
+   * from outside the image contribute to neither
    */
   float Linearize(const cv::Mat &, const Transform &T_init);
 
   /**
-   * applies smoothing to the image at the specified ROI
+   * \return the cost of the last linearization: sum_sq_ per residual it
+   * sums. Unlike sum_sq_, a pose does not get cheaper by warping the template
+   * out of the image or by dropping tiles
+   */
+  inline float Cost() const {
+    return num_residuals_ > 0 ? sum_sq_ / static_cast<float>(num_residuals_) : std::numeric_limits<float>::max();
+  }
+
+  /**
+   * finds the template pixels warped from outside the image by the last
+   * warp and removes their hessians from the solver
+   *
+   * \param inside the warped template is all inside the image
+   */
+  void UpdateVisibility(bool inside);
+
+  /**
+   * factorizes the hessian of the template pixels that are visible and not
+   * in a dropped tile
+   */
+  void UpdateSolver();
+
+  /**
+   * sizes the buffers of the tiles and of the visibility, and resets both
+   */
+  void ResetSolverState();
+
+  /**
+   * \return the fraction of the template pixels visible at the last
+   * linearization
+   */
+  inline float VisibleFraction() const {
+    const auto n = cdata_.pixels().size();
+    return n > 0 ? 1.0f - static_cast<float>(num_hidden_) / static_cast<float>(n) : 0.0f;
+  }
+
+  /**
+   * drops the tiles whose residuals look occluded and removes their hessians
+   * from the solver, see Parameters::occlusion_threshold
+   */
+  void DropOccludedTiles();
+
+  /**
+   * takes back all the dropped tiles
    */
-  void SmoothImage(cv::Mat &I, const cv::Rect &roi);
+  void ResetTiles();
+
+  /**
+   * applies smoothing to the image at the specified ROI. Pixels of I around
+   * the ROI are used for the border of the filter
+   *
+   * \param I input image
+   * \param roi region of I to smooth
+   * \param dst the smoothed region, may be I when roi covers all of I
+   */
+  void SmoothImage(const cv::Mat &I, const cv::Rect &roi, cv::Mat &dst);
+
+  /**
+   * region of the image (I_1) to preprocess for the given initialization: the
+   * predicted template location plus the search margin, clipped to the part
+   * of the image that is available
+   *
+   * \param T_init initialization of the transform
+   * \param extent part of the image that is available
+   */
+  cv::Rect SearchRegion(const Transform &T_init, const cv::Rect &extent) const;
 
 
 protected:
@@ -74,16 +225,46 @@ protected:
   ChannelDataType cdata_;          //< holds the multi-channel data
   cv::Rect bbox_;                  //< the template's bounding box
   cv::Mat I_, Iw_;                 //< buffers for input image and warped image
+  cv::Mat I_buf_;                  //< storage of I_, reserved for the template image size
+  Arena arena_;                    //< owns the buffers when setTemplate is not given an arena
+  cv::Point offset_;               //< location of I_ in the input image
+  cv::Rect valid_;                 //< region of I_ smoothed from pixels of the input image only
+  imgproc::GaussianFilter filter_;    //< smoothing filter with sigma from params_
+  cv::Ptr<cv::CLAHE> clahe_;       //< contrast equalization of the template images
   Matrix33f T_, T_inv_;            //< normalization matrices
   Gradient gradient_;              //< gradient of the cost function
-  Vector_<float> residuals_;       //< vector of residuals
+  Residuals residuals_;            //< vector of residuals
+  float sum_sq_ = 0.0f;            //< sum of squared residuals of the last linearization
+  int num_residuals_ = 0;          //< residuals summed in sum_sq_
   Solver solver_;                  //< the linear solver
   int interp_;                     //< interpolation, e.g. cv::INTER_LINEAR
+  const std::atomic<float> *cost_bound_ = nullptr;  //< see setCostBound
+  typename EigenStdVector<Gradient>::type tile_gradients_;  //< gradient of each tile
+  std::vector<float> tile_sum_sq_;            //< sum of squared residuals of each tile
+  std::vector<float> tile_errors_;            //< scratch buffer of DropOccludedTiles, 2 per tile
+  std::vector<uint8_t> tile_dropped_;         //< the tile is left out of the solve
+  int num_dropped_ = 0;
+  std::vector<int> warp_bounds_;              //< columns of Iw_ warped from inside the image, 2 per row
+  std::vector<int> visible_cols_;             //< visible columns of the sampling grid, 2 per row
+  std::vector<int> cols_buf_;                 //< scratch buffer of UpdateVisibility, same size
+  typename EigenStdVector<Hessian>::type tile_hidden_hessians_;  //< hessian of the hidden pixels of each tile
+  std::vector<int> tile_hidden_pixels_;       //< hidden pixels of each tile
+  int num_hidden_ = 0;                        //< template pixels warped from outside the image
 
 public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
 };
 
+/**
+ * Coarse to fine tracker over an image pyramid
+ *
+ * Thread safety: same as Tracker, distinct instances can be used concurrently
+ * and one instance from one thread at a time. The worker threads that
+ * PyramidTracker starts itself (setTemplateAsync, setTemplate of the levels)
+ * only touch data that the calling thread does not use until they are joined.
+ * A motion predictor given to setMotionPredictor must not be shared between
+ * instances
+ */
 template<class M>
 class PyramidTracker {
   typedef Tracker<M> Tracker;
@@ -91,15 +272,22 @@ class PyramidTracker {
 public:
   typedef typename Tracker::Transform Transform;
   typedef typename Tracker::MotionModelType MotionModelType;
+  typedef MotionPredictor<M> MotionPredictorType;
+
+  /**
+   * called with the result refined at level 0 and the timestamp of its frame,
+   * see TrackCoarse
+   */
+  typedef std::function<void(const Result &, double)> RefineCallback;
 
 public:
   explicit PyramidTracker(const Parameters &p = Parameters())
-    : alg_params_(p) {
+    : alg_params_(p), predictor_(MakeMotionPredictor<M>(p.motion_predictor)) {
     if (alg_params_.verbose)
       std::cout << "AlgorithmParameters:\n" << alg_params_ << std::endl;
   }
 
-  ~PyramidTracker() = default;
+  ~PyramidTracker();
 
   /**
    * sets the template
@@ -109,29 +297,362 @@ public:
    */
   void setTemplate(const cv::Mat &, const cv::Rect &bbox);
 
+  /**
+   * sets a template of arbitrary shape, see Tracker::setTemplate. The mask is
+   * downsampled with the levels
+   *
+   * \param mask CV_8UC1 of the size of bbox, empty for the whole bbox
+   */
+  void setTemplate(const cv::Mat &I, const cv::Rect &bbox, const cv::Mat &mask);
+
+  /**
+   * sets a template made of rectangles that move together, e.g. the parts of
+   * a planar object around an occluder or a hole. Rectangles that overlap are
+   * merged: the template is their union, each pixel is tracked once
+   *
+   * \param rects the parts of the template, at least one, none of them empty
+   */
+  void setTemplate(const cv::Mat &I, const std::vector<cv::Rect> &rects);
+
+  /**
+   * sets the template without blocking. The template data is built on a
+   * worker thread while Track keeps using the current template; the first call
+   * to Track after it is ready swaps it in, as if setTemplate was called right
+   * before. The buffers of the replaced template are reused by the next call
+   * when the sizes match
+   *
+   * A template that is still being built is superseded by the next call to
+   * setTemplate or setTemplateAsync. Must be called from the thread calling
+   * Track
+   *
+   * \param I reference image, copied before returning
+   * \param bbox template location
+   */
+  void setTemplateAsync(const cv::Mat &I, const cv::Rect &bbox);
+
+  /**
+   * updates part of the template on all levels, see Tracker::updateTemplate.
+   * Applies to the template in use, not to one pending from setTemplateAsync
+   *
+   * \param I the new template image, same size as the one of setTemplate
+   * \param region region of I to update
+   * \return the number of updated template pixels at level 0
+   */
+  int updateTemplate(const cv::Mat &I, const cv::Rect &region);
+
+  /**
+   * \return true if a template set with setTemplateAsync is not in use yet
+   */
+  inline bool hasPendingTemplate() const { return worker_.joinable() || pending_ready_; }
+
+  /**
+   * blocks until the template set with setTemplateAsync is built, and swaps it
+   * in
+   */
+  void waitForTemplate();
+
   /**
    * Tracks the template
    *
    * \param I input image
    * \param T pose to use for initialization
+   *
+   * The frame is assumed to be one time unit after the previous one
    */
-  Result Track(const cv::Mat &, const Transform &);
+  Result Track(const cv::Mat &I, const Transform &T) {
+    BeginFrame();
+    return DoTrack(I, nullptr, T, true, time_ + 1.0);
+  }
 
   /**
    * Tracks the template
    *
    * \param I input image
    *
-   * Uses the previously estimated pose for initialization
+   * Uses the motion predictor for initialization, or the previously estimated
+   * pose if there is none. The frame is assumed to be one time unit after the
+   * previous one
    */
   Result Track(const cv::Mat &I) {
-    return Track(I, T_init_);
+    return Track(I, time_ + 1.0);
+  }
+
+  /**
+   * Tracks the template
+   *
+   * \param I input image
+   * \param timestamp time of the frame, used by the motion predictor
+   */
+  Result Track(const cv::Mat &I, double timestamp);
+
+  /**
+   * Tracks the template in a frame whose image pyramid is already built, e.g.
+   * once for several trackers
+   *
+   * \param pyr the frame pyramid, pyr[i] is pyr[i - 1] down-sampled with
+   * imgproc::PyrDown. Must have at least numLevels() levels
+   * \param T pose to use for initialization
+   */
+  Result Track(const std::vector<cv::Mat> &pyr, const Transform &T) {
+    BeginFrame();
+    return DoTrack(pyr[0], &pyr, T, true, time_ + 1.0);
   }
 
+  /**
+   * Tracks the template in a frame whose image pyramid is already built
+   *
+   * \param pyr the frame pyramid, see above
+   * \param timestamp time of the frame, used by the motion predictor
+   */
+  Result Track(const std::vector<cv::Mat> &pyr, double timestamp);
+
+  /**
+   * Tracks the template down to level 1 and returns, the pose is refined at
+   * level 0 on a worker thread meanwhile
+   *
+   * The next frame starts from the refined pose if its refinement is done by
+   * then, from the coarse one otherwise. A refinement that has not started
+   * when the next frame comes is superseded by the one of that frame. With a
+   * single level, or when the adaptive levels skip level 0, the frame is
+   * tracked as with Track and not refined
+   *
+   * \param I input image. The part of it around the template is copied for the
+   * refinement, I can be reused once TrackCoarse returns
+   * \param timestamp time of the frame, used by the motion predictor
+   * \param on_refined called on the worker thread once the frame is refined
+   * \return the result of the coarse levels, Result::level is the level it was
+   * estimated at
+   */
+  Result TrackCoarse(const cv::Mat &I, double timestamp, RefineCallback on_refined = RefineCallback());
+
+  /**
+   * same as above for a frame whose image pyramid is already built, see Track
+   */
+  Result TrackCoarse(const std::vector<cv::Mat> &pyr, double timestamp,
+                     RefineCallback on_refined = RefineCallback());
+
+  /**
+   * waits until the refinements queued by TrackCoarse are done and their
+   * callbacks returned
+   */
+  void waitForRefinement();
+
+  /**
+   * \param r output, the last refined result
+   * \param timestamp output, the timestamp of its frame
+   * \return false if no frame was refined since the template was set
+   */
+  bool refinedResult(Result &r, double &timestamp) const;
+
+  /**
+   * \return the number of pyramid levels of the template
+   */
+  inline int numLevels() const { return static_cast<int>(data_.pyramid.size()); }
+
+  /**
+   * sets the motion predictor used to initialize the frames, nullptr to use
+   * the previous pose
+   */
+  inline void setMotionPredictor(const std::shared_ptr<MotionPredictorType> &p) {
+    predictor_ = p;
+    if (predictor_) predictor_->reset();
+  }
+
+  inline const std::shared_ptr<MotionPredictorType> &motionPredictor() const { return predictor_; }
+
+  /**
+   * \return the memory holding the template data and buffers of all levels
+   */
+  inline const Arena &arena() const { return data_.arena; }
+
+private:
+  /**
+   * template data of all levels
+   */
+  struct TemplateData {
+    typename EigenStdVector<Tracker>::type pyramid;
+    Arena arena;                     //< template data and buffers of all levels
+    std::vector<cv::Mat> I_pyr_buf;  //< storage of the levels, reserved at setTemplate
+    cv::Rect bbox;                   //< template location at level 0
+    cv::Mat image;                   //< copy of the image given to setTemplateAsync
+  };
+
+  /**
+   * a frame to refine at level 0, see TrackCoarse
+   */
+  struct Refinement {
+    cv::Mat image;             //< copy of level 0 of the frame pyramid, in refine_buf_[buffer]
+    int buffer = -1;
+    cv::Point origin;          //< location of image in the frame
+    Transform T = Transform::Identity();  //< the coarse pose
+    double timestamp = 0.0;
+    float max_time_us = 0.0f;  //< what is left of the time budget of the frame
+    int64_t frame = -1;        //< index of the frame, see num_frames_
+    RefineCallback callback;
+  };
+
+  /**
+   * tracks a frame, after BeginFrame
+   *
+   * \param I the frame
+   * \param frame_pyr pyramid of the frame, nullptr to build it from I
+   * \param pose_given T_init comes from the caller rather than from the
+   * motion history; the frame is tracked from it even when it did not change,
+   * unless it is the previous pose
+   * \param on_refined nullptr to track down to level 0, otherwise level 0
+   * is refined on refine_thread_, see TrackCoarse
+   */
+  Result DoTrack(const cv::Mat &I, const std::vector<cv::Mat> *frame_pyr,
+                 const Transform &T_init, bool pose_given, double timestamp,
+                 const RefineCallback *on_refined = nullptr);
+
+  /**
+   * queues the refinement of the frame, replacing the one queued if any
+   *
+   * \param image level 0 of the frame pyramid, copied into the refinement
+   * buffer that the running refinement does not use
+   * \param frame_size size of the frame, the buffers are reserved for it
+   */
+  void QueueRefinement(Refinement &&job, const cv::Mat &image, const cv::Size &frame_size);
+
+  /**
+   * drops the queued refinement and waits for the running one, before the
+   * template changes
+   */
+  void CancelRefinement();
+
+  /**
+   * takes the refined pose of the last frame if it is done, and gives the
+   * pose of the last frame to the motion predictor
+   */
+  void ApplyRefinement();
+
+  void refineLoop();
+
+  /**
+   * tracks the template coarse to fine over the levels [finest, coarsest] of
+   * the frame pyramid
+   *
+   * \param levels the trackers of the levels, data_.pyramid or a workspace
+   * \param roi location of the frame pyramid in the frame
+   * \param timer started at the beginning of the frame, for the time budget
+   * \param last_level the level the result was estimated at, if not nullptr
+   */
+  Result TrackLevels(typename EigenStdVector<Tracker>::type &levels, const Transform &T_init,
+                     int finest, int coarsest, const cv::Rect &roi, Timer timer, int *last_level);
+
+  /**
+   * sets hypotheses_ to the initializations to track, see
+   * Parameters::num_hypotheses
+   */
+  void SelectHypotheses(const Transform &T_init);
+
+  /**
+   * tracks all of hypotheses_ concurrently
+   *
+   * \return the converged result with the lowest cost, or the one of the
+   * first hypothesis if none converged
+   */
+  Result TrackHypotheses(int finest, int coarsest, const cv::Rect &roi, const Timer &timer);
+
+  /**
+   * swaps in a pending template and takes the refinement of the last frame,
+   * once at the start of each frame so that the pose is predicted and tracked
+   * with the same template
+   */
+  void BeginFrame();
+
+  /**
+   * starts the frame, see BeginFrame, and predicts its pose
+   */
+  Transform PredictPose(double timestamp);
+
+  /**
+   * builds the template data of all levels, reusing the memory of data. The
+   * coarse levels are set on template_pool_, one build at a time
+   *
+   * \param mask mask of the template at level 0, empty for the whole bbox
+   */
+  void BuildTemplate(const cv::Mat &I, const cv::Rect &bbox, const cv::Mat &mask, TemplateData &data);
+
+  /**
+   * resets the tracking state after the template changed
+   */
+  void ResetTemplateState();
+
+  /**
+   * swaps in the template built by setTemplateAsync if it is ready
+   *
+   * \return true if the template changed
+   */
+  bool SwapTemplate();
+
+
+  /**
+   * selects the range of levels [finest, coarsest] to run for the frame
+   *
+   * \param T_init pose to use for initialization
+   */
+  void SelectLevels(const Transform &T_init, int &finest, int &coarsest) const;
+
+  /**
+   * region of the image to build the pyramid from: the predicted template
+   * location plus the search margin and the filter borders of each level
+   *
+   * The origin is a multiple of the size of a pixel at the coarsest level
+   */
+  cv::Rect PyramidRegion(const Transform &T_init, const cv::Size &size, int coarsest) const;
+
+  /**
+   * samples the image on a sparse grid over the location of the template at
+   * the last estimated pose
+   *
+   * \return false if the template is not visible
+   */
+  bool SampleFrame(const cv::Mat &I, std::vector<uint8_t> &samples) const;
+
+  /**
+   * \return true if the frame did not change since the last tracked frame
+   */
+  bool IsFrameUnchanged(const cv::Mat &I);
+
 private:
   Parameters alg_params_;
-  std::vector<Tracker> pyramid_;
+  TemplateData data_;                          //< the template in use
+  TemplateData pending_;                       //< the template built by setTemplateAsync
+  std::thread worker_;                         //< builds pending_
+  std::unique_ptr<ThreadPool> template_pool_;  //< sets the coarse levels of BuildTemplate
+  std::atomic<bool> pending_ready_{false};     //< pending_ is built and can be swapped in
+  std::vector<cv::Mat> I_pyr_;                 //< image pyramid of the current frame
   Transform T_init_ = Transform::Identity();
+  float last_motion_ = -1.0f;                  //< corner motion of the last frame, < 0 if unknown
+  std::shared_ptr<MotionPredictorType> predictor_;
+  double time_ = 0.0;                          //< timestamp of the last frame
+  Result last_result_;                         //< result of the last tracked frame
+  std::vector<uint8_t> ref_samples_;           //< samples of the last tracked frame, empty if none
+  std::vector<uint8_t> samples_;               //< samples of the current frame
+  Transform T_key_ = Transform::Identity();    //< last pose that was not lost
+  typename EigenStdVector<Transform>::type hypotheses_;  //< initializations of the current frame
+  std::vector<typename EigenStdVector<Tracker>::type> workspaces_;  //< trackers of the other hypotheses
+  bool workspaces_stale_ = true;               //< the template changed since workspaces_ was built
+  std::unique_ptr<ThreadPool> pool_;           //< runs the other hypotheses
+  std::atomic<float> cost_bound_{0.0f};        //< lowest cost of the converged hypotheses, times a margin
+  std::vector<Result> hyp_results_;            //< result of each hypothesis
+  std::vector<int> hyp_levels_;                //< level each result was estimated at
+  std::thread refine_thread_;                  //< refines the frames of TrackCoarse at level 0
+  mutable std::mutex refine_mutex_;            //< protects the refinement state below
+  std::condition_variable refine_cv_;          //< signaled when a refinement is queued or done
+  Refinement refine_job_;                      //< the queued refinement
+  cv::Mat refine_buf_[2];                      //< copies of the frames to refine, see QueueRefinement
+  int refine_running_buf_ = -1;                //< buffer of the running refinement, -1 if none
+  bool refine_queued_ = false;
+  bool refining_ = false;                      //< refine_thread_ uses the level 0 tracker
+  bool refine_stop_ = false;
+  Result refined_;                             //< result of the last refinement
+  int64_t refined_frame_ = -1;                 //< frame of refined_, -1 if none
+  double refined_time_ = 0.0;                  //< timestamp of refined_
+  int64_t num_frames_ = 0;                     //< frames tracked since the template was set
+  bool deferred_update_ = false;               //< the predictor waits for the refinement of the last frame
 };
 
 NAMESPACE_END
@@ -33,6 +33,21 @@ std::string ToString(OptimizerStatus status) {
     case OptimizerStatus::SmallAbsParameters:
       s = "SmallAbsParameters";
       break;
+    case OptimizerStatus::TimeBudgetExceeded:
+      s = "TimeBudgetExceeded";
+      break;
+    case OptimizerStatus::Diverged:
+      s = "Diverged";
+      break;
+    case OptimizerStatus::FrameUnchanged:
+      s = "FrameUnchanged";
+      break;
+    case OptimizerStatus::Cancelled:
+      s = "Cancelled";
+      break;
+    case OptimizerStatus::Failed:
+      s = "Failed";
+      break;
   }
 
   return s;
@@ -42,8 +57,13 @@ std::ostream &operator<<(std::ostream &os, const Result &r) {
   os << "OptimizerStatus: " << ToString(r.status) << "\n";
   os << "NumIterations: " << r.num_iterations << "\n";
   os << "FinalSsdError: " << r.final_ssd_error << "\n";
+  os << "FinalCost: " << r.final_cost << "\n";
   os << "FirstOrderOptimality: " << r.first_order_optimality << "\n";
   os << "TimeMilliSeconds: " << r.time_ms << "\n";
+  os << "DroppedTiles: " << r.dropped_tiles << "\n";
+  os << "VisibleFraction: " << r.visible_fraction << "\n";
+  os << "Level: " << r.level << "\n";
+  os << "NumLevels: " << r.num_levels << "\n";
   os << "T:\n" << r.T;
   return os;
 }
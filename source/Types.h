@@ -58,6 +58,12 @@ enum class OptimizerStatus {
   SmallAbsError,          //< absolute error value is small
   SmallParameterUpdate,   //< current delta parameters is small
   SmallAbsParameters,     //< absolute parameter step is small
+  TimeBudgetExceeded,     //< the time budget was spent, best estimate returned
+  Diverged,               //< the optimization diverged and was aborted
+  FrameUnchanged,         //< the frame did not change, previous result returned
+  Cancelled,              //< stopped, the cost is above the bound set by another converged initialization,
+                          //< or the frame was cancelled before tracking
+  Failed,                 //< the tracker threw an exception, e.g. out of memory; the pose is not valid
 };
 
 /**
@@ -82,6 +88,9 @@ public:
   /** final sum of squared errors */
   float final_ssd_error = -1.0f;
 
+  /** final_ssd_error per residual it sums, comparable between poses that see a different part of the template */
+  float final_cost = -1.0f;
+
   /** first order optimiality, Inf norm of the gradient */
   float first_order_optimality = -1.0f;
 
@@ -93,6 +102,18 @@ public:
 
   bool successful = true;
 
+  /** number of template tiles dropped as occluded, see Parameters::tile_size */
+  int dropped_tiles = 0;
+
+  /** fraction of the template pixels warped from inside the image */
+  float visible_fraction = 1.0f;
+
+  /** pyramid level T was estimated at, 0 is the full resolution. T is at level 0 coordinates */
+  int level = 0;
+
+  /** number of pyramid levels tracked for the frame, from 'level' up. 0 when the frame was not tracked */
+  int num_levels = 1;
+
   friend std::ostream &operator<<(std::ostream &, const Result &);
 };
 
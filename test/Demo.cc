@@ -7,9 +7,9 @@
  */
 #include "Demo.h"
 
+#include "FramePool.h"
 #include "MotionModel.h"
-#include "Tracker.h"
-#include "BoundedBuffer.h"
+#include "PipelinedTracker.h"
 
 #include <memory>
 #include <string>
@@ -76,24 +76,13 @@ typedef struct ResultForDisplay {
   int time_ms;
 } ResultForDisplay;
 
-typedef struct GuiData {
-  ImagePtr image;
-  ImagePtr gray;
-  NAMESPACE::Result result;
-
-  GuiData() : image(new cv::Mat), gray(new cv::Mat) {}
-
-  void swap(GuiData &&other) {
-    image.swap(other.image);
-    gray.swap(other.gray);
-    std::swap(result, other.result);
-  }
-} GuiData;
+struct DemoLiveCapture::Impl {
+  typedef NAMESPACE::PipelinedTracker<NAMESPACE::Homography> TrackerType;
 
-typedef NAMESPACE::BoundedBuffer<std::unique_ptr<GuiData>> ImageBufferType;
+  // 3 frames, so that a new frame cancels the stale ones instead of waiting
+  // for the one being tracked, see PipelinedTracker::setDropStale
+  static constexpr int kPipelineDepth = 3;
 
-struct DemoLiveCapture::Impl {
-  typedef NAMESPACE::PyramidTracker<NAMESPACE::Homography> TrackerType;
   Impl() : cap_() {
     if (!cap_.isOpened()) {
       cap_.open(0);
@@ -107,7 +96,8 @@ struct DemoLiveCapture::Impl {
     params.subsampling = 2;
     params.verbose = false;
 
-    tracker_.reset(new TrackerType(params));
+    tracker_.reset(new TrackerType(params, kPipelineDepth));
+    tracker_->setDropStale(true);
     main_thread_.reset(new std::thread(&DemoLiveCapture::Impl::mainThread, this));
   }
 
@@ -132,15 +122,13 @@ struct DemoLiveCapture::Impl {
 
   std::atomic<bool> stop_requested_{false};
   std::unique_ptr<TrackerType> tracker_;
+  std::unique_ptr<NAMESPACE::FramePool> pool_;
   cv::Rect roi_;
 
   std::unique_ptr<std::thread> main_thread_;
   std::unique_ptr<std::thread> display_thread_;
   std::unique_ptr<std::thread> data_thread_;
 
-  std::unique_ptr<ImageBufferType> data_buffer_;
-  std::unique_ptr<ImageBufferType> results_buffer_;
-
   void displayThread();
 
   void mainThread();
@@ -231,11 +219,11 @@ void DemoLiveCapture::Impl::mainThread() {
     return;
   }
 
-  data_buffer_.reset(new ImageBufferType(10));
-  results_buffer_.reset(new ImageBufferType(10));
+  tracker_->setTemplate(image, handle_data.roi);
 
-  cv::cvtColor(image, image_copy, cv::COLOR_BGR2GRAY);
-  tracker_->setTemplate(image_copy, handle_data.roi);
+  // the frames in the pipeline, the one being captured, the one displayed and
+  // a tracked one waiting for the display
+  pool_.reset(new NAMESPACE::FramePool(kPipelineDepth + 3, image.size(), image.type()));
 
   cv::destroyWindow(window_name);
   data_thread_.reset(new std::thread(&DemoLiveCapture::Impl::dataThread, this));
@@ -244,38 +232,50 @@ void DemoLiveCapture::Impl::mainThread() {
 
   roi_ = handle_data.roi;
   cv::Mat dimg;
-  NAMESPACE::Matrix33f tform(NAMESPACE::Matrix33f::Identity());
   while (!stop_requested_) {
 
-    std::unique_ptr<GuiData> data;
-    if (data_buffer_->pop(&data)) {
-      data->result = tracker_->Track(*data->gray, tform);
-
-      tform = data->result.T;
-
-      DrawTrackingResult(dimg, *data->image, roi_, tform.data());
-      cv::imshow("bitplanes", dimg);
+    // the gray conversion and the pyramid of the next frame are done while
+    // this one is tracked. The frames cancelled by a newer one come back
+    // without a pose, only their buffer is given back
+    TrackerType::FrameResult data;
+    if (tracker_->pop(data)) {
+      const bool cancelled = data.result.status == NAMESPACE::OptimizerStatus::Cancelled;
+      if (!cancelled) {
+        DrawTrackingResult(dimg, data.image, roi_, data.result.T.data());
+        cv::imshow("bitplanes", dimg);
+      }
+      pool_->release(std::move(data.image));
 
-      int k = 0xff & cv::waitKey(5);
+      int k = cancelled ? 0 : 0xff & cv::waitKey(5);
       if (k == 'q') {
         stop_requested_ = true;
       }
+    } else {
+      std::this_thread::yield();
     }
   }
+
+  const NAMESPACE::FramePool::Stats stats = pool_->stats();
+  printf("frame pool: %lld frames, exhausted %lld times, waited %.1f ms\n",
+         static_cast<long long>(stats.acquired), static_cast<long long>(stats.exhausted), stats.wait_ms);
 }
 
 void DemoLiveCapture::Impl::dataThread() {
-  std::unique_ptr<GuiData> data(new GuiData);
   while (!stop_requested_) {
 
-    cap_ >> *data->image;
-    if (data->image->empty()) {
+    // the capture reuses the memory of the pooled buffer, which the pipeline
+    // shares until it is displayed and released
+    cv::Mat image;
+    if (!pool_->acquire(&image))
+      continue;
+    cap_ >> image;
+    if (image.empty()) {
       printf("failed to get image\n");
+      pool_->release(std::move(image));
+      continue;
     }
 
-    cv::cvtColor(*data->image, *data->gray, cv::COLOR_BGR2GRAY);
-    data_buffer_->push(std::move(data));
-    data.reset(new GuiData);
+    tracker_->push(image);
   }
 }
 
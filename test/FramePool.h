@@ -0,0 +1,113 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/14 10:30
+ * @Description: Pool of frame buffers recycled between capture and tracking
+ * @FilePath: Bitplanes/test/FramePool.h
+ */
+#pragma once
+
+#include "API.h"
+#include "SpscRing.h"
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+NAMESPACE_BEGIN
+/**
+ * Fixed set of preallocated frame buffers
+ *
+ * The capture thread takes a free buffer, captures into it and hands it to
+ * the tracker; the consumer gives it back once the frame is displayed. The
+ * free list is a SpscRing, so one thread acquires and one thread releases.
+ * When all the buffers are in use, acquire waits for one to come back and
+ * counts the pool as exhausted; a capture thread always waiting there means
+ * the pool is too small, or the consumer is too slow
+ */
+class FramePool {
+public:
+  /**
+   * counters of acquire
+   */
+  struct Stats {
+    int64_t acquired = 0;    //< buffers given by acquire
+    int64_t exhausted = 0;   //< times acquire found no free buffer and had to wait
+    float wait_ms = 0.0f;    //< total time acquire waited
+  };
+
+public:
+  /**
+   * \param num_buffers number of buffers, at least the frames in flight plus
+   * the one being captured
+   * \param size size of the frames
+   * \param type type of the frames
+   */
+  FramePool(int num_buffers, const cv::Size &size, int type)
+    : free_(static_cast<size_t>(num_buffers)), num_buffers_(num_buffers) {
+    for (int i = 0; i < num_buffers; ++i) {
+      cv::Mat buf(size, type);
+      free_.push(std::move(buf));
+    }
+  }
+
+  FramePool(const FramePool &) = delete;
+
+  FramePool &operator=(const FramePool &) = delete;
+
+  /**
+   * takes a free buffer, waits until one is released if there is none
+   *
+   * \param buf the buffer
+   * \param wait_time_ms how long to wait for a buffer
+   * \return false if no buffer was released in time
+   */
+  bool acquire(cv::Mat *buf, int wait_time_ms = 100) {
+    if (free_.tryPop(*buf)) {
+      acquired_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    // 所有缓冲都在使用中，等待归还
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    const bool ok = free_.popFor(*buf, std::chrono::milliseconds(wait_time_ms));
+    const auto wait_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    exhausted_.fetch_add(1, std::memory_order_relaxed);
+    wait_us_.fetch_add(static_cast<int64_t>(wait_us), std::memory_order_relaxed);
+    if (ok)
+      acquired_.fetch_add(1, std::memory_order_relaxed);
+    return ok;
+  }
+
+  /**
+   * gives a buffer back. No other reference to its data must be left
+   */
+  void release(cv::Mat &&buf) {
+    free_.push(std::move(buf));
+  }
+
+  inline int numBuffers() const { return num_buffers_; }
+
+  /**
+   * \return the number of free buffers
+   */
+  inline int available() const { return static_cast<int>(free_.size()); }
+
+  Stats stats() const {
+    Stats ret;
+    ret.acquired = acquired_.load(std::memory_order_relaxed);
+    ret.exhausted = exhausted_.load(std::memory_order_relaxed);
+    ret.wait_ms = static_cast<float>(wait_us_.load(std::memory_order_relaxed)) / 1000.0f;
+    return ret;
+  }
+
+private:
+  SpscRing<cv::Mat> free_;  //< the free list
+  int num_buffers_;
+  std::atomic<int64_t> acquired_{0};
+  std::atomic<int64_t> exhausted_{0};
+  std::atomic<int64_t> wait_us_{0};
+};
+
+NAMESPACE_END
@@ -0,0 +1,265 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/13 14:05
+ * @Description: Lock-free single producer single consumer ring buffer
+ * @FilePath: Bitplanes/test/SpscRing.h
+ */
+#pragma once
+
+#include "API.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+NAMESPACE_BEGIN
+/**
+ * what push does when the ring is full
+ */
+enum class OverflowPolicy {
+  Block,       //< waits until the consumer takes an element
+  DropOldest,  //< replaces the oldest unread element
+  LatestOnly   //< drops all the unread elements, the consumer always gets the newest one
+};
+
+/**
+ * Ring buffer between one producer thread and one consumer thread, without
+ * locks
+ *
+ * Each cell has a sequence number telling whether it is free for the
+ * producer or holds an element for the consumer. The consumer claims the
+ * oldest element by advancing the read position with a compare and swap; so
+ * does the producer when it drops unread elements, which is the only case
+ * where both threads write the same position. A thread that has to wait,
+ * push with OverflowPolicy::Block on a full ring or pop on an empty one,
+ * yields a few times and then blocks on a condition variable; the other
+ * thread takes the mutex to wake it only when it sees a waiter
+ */
+template<class T>
+class SpscRing {
+public:
+  /**
+   * \param capacity number of elements, rounded up to a power of 2
+   * \param policy what push does when the ring is full
+   */
+  explicit SpscRing(size_t capacity, OverflowPolicy policy = OverflowPolicy::Block)
+    : policy_(policy) {
+    capacity_ = 1;
+    while (capacity_ < capacity)
+      capacity_ <<= 1;
+    mask_ = capacity_ - 1;
+    cells_.reset(new Cell[capacity_]);
+    for (size_t i = 0; i < capacity_; ++i)
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  SpscRing(const SpscRing &) = delete;
+
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  /**
+   * adds an element, see OverflowPolicy for a full ring. Producer thread only
+   */
+  void push(T &&item) {
+    const size_t t = tail_.load(std::memory_order_relaxed);
+
+    // 1.只保留最新元素时，丢弃所有未读的元素
+    if (policy_ == OverflowPolicy::LatestOnly) {
+      size_t h = head_.load(std::memory_order_acquire);
+      while (h != t) {
+        if (head_.compare_exchange_weak(h, h + 1, std::memory_order_acq_rel)) {
+          Cell &c = cells_[h & mask_];
+          c.value = T();
+          c.seq.store(h + capacity_, std::memory_order_release);
+          dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+          ++h;
+        }
+      }
+    }
+
+    // 2.等待单元空闲；满时按策略等待或取走最旧的元素，消费者正在读取该单元时等它读完
+    Cell &c = cells_[t & mask_];
+    if (policy_ == OverflowPolicy::Block) {
+      Wait([&]() { return c.seq.load(std::memory_order_acquire) == t; }, nullptr);
+    } else {
+      while (c.seq.load(std::memory_order_acquire) != t) {
+        size_t h = t - capacity_;
+        if (head_.compare_exchange_strong(h, h + 1, std::memory_order_acq_rel)) {
+          dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+          break;
+        }
+        std::this_thread::yield();
+      }
+    }
+
+    // 3.写入并发布，唤醒等待元素的消费者
+    c.value = std::move(item);
+    c.seq.store(t + 1, std::memory_order_release);
+    tail_.store(t + 1, std::memory_order_release);
+    Notify();
+  }
+
+  /**
+   * takes the oldest element. Consumer thread only
+   *
+   * \return false if the ring is empty
+   */
+  bool tryPop(T &item) {
+    if (!Take(item))
+      return false;
+    Freed();
+    return true;
+  }
+
+  /**
+   * takes the oldest element, waits until there is one. Consumer thread only
+   */
+  void pop(T &item) {
+    Wait([&]() { return Take(item); }, nullptr);
+    Freed();
+  }
+
+  /**
+   * takes the oldest element, waits at most timeout for one. Consumer thread
+   * only
+   *
+   * \return false if the ring stayed empty
+   */
+  template<class Rep, class Period>
+  bool popFor(T &item, const std::chrono::duration<Rep, Period> &timeout) {
+    const Clock::time_point deadline = Clock::now() + timeout;
+    if (!Wait([&]() { return Take(item); }, &deadline))
+      return false;
+    Freed();
+    return true;
+  }
+
+  /**
+   * \return the number of unread elements, may be outdated by the time it
+   * returns
+   */
+  inline size_t size() const {
+    const size_t h = head_.load(std::memory_order_acquire);
+    const size_t t = tail_.load(std::memory_order_acquire);
+    return t - h;
+  }
+
+  inline size_t capacity() const { return capacity_; }
+
+  /**
+   * \return the number of elements dropped by push
+   */
+  inline size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * takes the oldest element without waking the producer, so that it can be
+   * called under wait_mutex_
+   *
+   * \return false if the ring is empty
+   */
+  bool Take(T &item) {
+    size_t h = head_.load(std::memory_order_acquire);
+    for (;;) {
+      Cell &c = cells_[h & mask_];
+      if (c.seq.load(std::memory_order_acquire) != h + 1)
+        return false;
+
+      // 生产者可能同时丢弃了该元素，此时重新读取
+      if (head_.compare_exchange_weak(h, h + 1, std::memory_order_acq_rel)) {
+        item = std::move(c.value);
+        c.seq.store(h + capacity_, std::memory_order_release);
+        return true;
+      }
+    }
+  }
+
+  /**
+   * a cell became free: wakes a producer waiting in a Block push
+   */
+  inline void Freed() {
+    if (policy_ == OverflowPolicy::Block)
+      Notify();
+  }
+
+  /**
+   * waits until ready() returns true or the deadline passes: yields
+   * SPIN_COUNT times, then blocks until the other thread calls Notify
+   *
+   * \param deadline nullptr to wait without a deadline
+   * \return the last value of ready()
+   */
+  template<class Pred>
+  bool Wait(Pred ready, const Clock::time_point *deadline) {
+    // 1.短暂等待时让出CPU即可，不加锁
+    for (int i = 0; i < SPIN_COUNT; ++i) {
+      if (ready())
+        return true;
+      if (deadline && Clock::now() >= *deadline)
+        return false;
+      std::this_thread::yield();
+    }
+
+    // 2.登记为等待者后在锁内检查条件再阻塞，另一线程发布后看到等待者会加锁唤醒，不会丢失唤醒
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool ok;
+    {
+      std::unique_lock<std::mutex> lock(wait_mutex_);
+      while (!(ok = ready())) {
+        if (!deadline) {
+          wait_cv_.wait(lock);
+        } else if (wait_cv_.wait_until(lock, *deadline) == std::cv_status::timeout) {
+          ok = ready();
+          break;
+        }
+      }
+    }
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+    return ok;
+  }
+
+  /**
+   * wakes the other thread if it blocks in Wait, called after publishing a
+   * change of the cells
+   */
+  inline void Notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> lock(wait_mutex_);
+      wait_cv_.notify_all();
+    }
+  }
+
+  struct Cell {
+    std::atomic<size_t> seq;  //< == position: free for push, == position + 1: holds an element
+    T value;
+  };
+
+  static constexpr size_t kCacheLine = 64;
+  static constexpr int SPIN_COUNT = 64;  //< yields before blocking, covers a short wait without a system call
+
+private:
+  std::unique_ptr<Cell[]> cells_;
+  size_t capacity_;
+  size_t mask_;
+  OverflowPolicy policy_;
+  char pad0_[kCacheLine];
+  std::atomic<size_t> head_{0};     //< position of the oldest element, written by both threads
+  char pad1_[kCacheLine - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail_{0};     //< position of the next push, written by the producer
+  std::atomic<size_t> dropped_{0};  //< written by the producer
+  char pad2_[kCacheLine - 2 * sizeof(std::atomic<size_t>)];
+  std::atomic<int> waiters_{0};     //< threads blocked or about to block in Wait
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cv_;
+};
+
+NAMESPACE_END
@@ -0,0 +1,86 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/15 10:20
+ * @Description: Test of the per-frame selection of the pyramid levels,
+ * Parameters::adaptive_levels
+ * @FilePath: Bitplanes/test/TestAdaptiveLevels.cc
+ */
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <iostream>
+
+using namespace NAMESPACE;
+
+typedef PyramidTracker<Homography> TrackerType;
+
+/**
+ * tracks frames moving by (step_x, step_y) pixels per frame
+ *
+ * \param min_levels output, the fewest levels tracked after the first frame
+ * \param max_levels output, the most levels tracked after the first frame
+ * \return 1 if a frame was lost
+ */
+static int TrackMotion(const Parameters &params, float step_x, float step_y, int num_frames,
+                       int &min_levels, int &max_levels) {
+  const cv::Rect bbox(100, 80, 100, 90);
+  TrackerType tracker(params);
+  tracker.setTemplate(MakeImage(0.0f, 0.0f), bbox);
+
+  // 1.the motion of the first frame is unknown, it runs all the levels
+  Result r = tracker.Track(MakeImage(step_x, step_y));
+  CHECK(r.num_levels == params.num_levels && r.level == 0);
+
+  min_levels = params.num_levels;
+  max_levels = 0;
+  for (int i = 2; i <= num_frames; ++i) {
+    const float dx = step_x * static_cast<float>(i), dy = step_y * static_cast<float>(i);
+    r = tracker.Track(MakeImage(dx, dy));
+    CHECK(r.successful && r.level == 0);
+    CHECK(std::abs(r.T(0, 2) - dx) < 1.5f && std::abs(r.T(1, 2) - dy) < 1.5f);
+    min_levels = std::min(min_levels, r.num_levels);
+    max_levels = std::max(max_levels, r.num_levels);
+  }
+  return 0;
+}
+
+int main() {
+  Parameters params;
+  params.num_levels = 4;
+  params.max_iterations = 50;
+  params.verbose = false;
+  params.adaptive_levels = true;
+  params.level_motion_pixels = 2.0f;
+
+  // 1.a nearly static scene needs the finest level only
+  int min_levels = 0, max_levels = 0;
+  if (TrackMotion(params, 0.2f, 0.1f, 8, min_levels, max_levels))
+    return 1;
+  std::cout << "static: " << min_levels << " to " << max_levels << " levels" << std::endl;
+  CHECK(max_levels == 1);
+
+  // 2.a motion above 2^(n - 1) level_motion_pixels keeps the full pyramid
+  if (TrackMotion(params, 9.0f, 2.0f, 5, min_levels, max_levels))
+    return 1;
+  std::cout << "fast: " << min_levels << " to " << max_levels << " levels" << std::endl;
+  CHECK(min_levels == params.num_levels);
+
+  // 3.a medium motion stops in between
+  if (TrackMotion(params, 5.0f, 0.0f, 8, min_levels, max_levels))
+    return 1;
+  std::cout << "medium: " << min_levels << " to " << max_levels << " levels" << std::endl;
+  CHECK(min_levels > 1 && max_levels < params.num_levels);
+
+  // 4.without adaptive_levels every frame runs all the levels
+  params.adaptive_levels = false;
+  if (TrackMotion(params, 0.2f, 0.1f, 4, min_levels, max_levels))
+    return 1;
+  CHECK(min_levels == params.num_levels);
+
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
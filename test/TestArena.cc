@@ -0,0 +1,64 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/29 11:05
+ * @Description: Test Arena
+ * @FilePath: Bitplanes/test/TestArena.cc
+ */
+#include "Arena.h"
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <iostream>
+
+using namespace NAMESPACE;
+
+static bool IsAligned(const void *p) {
+  return reinterpret_cast<uintptr_t>(p) % Arena::ALIGNMENT == 0;
+}
+
+int main() {
+  // 1.Aligned bump allocation within the reserved size
+  for (bool huge_pages : {false, true}) {
+    Arena arena;
+    CHECK(arena.reserve(1000, huge_pages));
+    CHECK(arena.capacity() >= 1000);
+    auto *a = arena.allocate<uint8_t>(3);
+    auto *b = arena.allocate<float>(10);
+    CHECK(a && b && IsAligned(a) && IsAligned(b));
+    CHECK(arena.contains(a) && arena.contains(b));
+    CHECK(arena.used() == Arena::Bytes(3) + Arena::Bytes<float>(10));
+    CHECK(arena.allocate(arena.capacity()) == nullptr);
+
+    // 2.reserving again reuses the block and discards the buffers
+    CHECK(arena.reserve(500, huge_pages));
+    CHECK(arena.used() == 0 && arena.allocate<uint8_t>(3) == a);
+
+    Arena moved(std::move(arena));
+    CHECK(moved.contains(a) && !arena.contains(a) && arena.capacity() == 0);
+  }
+
+  // 3.PyramidTracker places all levels in a single block
+  cv::Mat I(240, 320, CV_8UC1);
+  for (int y = 0; y < I.rows; ++y)
+    for (int x = 0; x < I.cols; ++x)
+      I.at<uint8_t>(y, x) = static_cast<uint8_t>(128 + 100 * std::sin(0.1 * x) * std::cos(0.07 * y));
+
+  Parameters params;
+  params.num_levels = 3;
+  params.verbose = false;
+  PyramidTracker<Homography> tracker(params);
+  tracker.setTemplate(I, cv::Rect(110, 70, 100, 100));
+  CHECK(tracker.arena().used() > 0 && tracker.arena().used() == tracker.arena().capacity());
+
+  const auto ret = tracker.Track(I);
+  CHECK((ret.T - Matrix33f::Identity()).norm() < 1e-2f);
+
+  std::cout << "Arena: " << tracker.arena().used() << " bytes" << std::endl;
+  return 0;
+}
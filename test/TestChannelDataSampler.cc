@@ -0,0 +1,90 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/30 15:30
+ * @Description: Test the template precomputation of ChannelDataSampler
+ * @FilePath: Bitplanes/test/TestChannelDataSampler.cc
+ */
+#include "ChannelDataSampler.h"
+#include "MotionModel.h"
+#include "LBP.h"
+#include "Timer.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <iostream>
+
+using namespace NAMESPACE;
+
+typedef ChannelDataSampler<Homography> Sampler;
+
+int main() {
+  const cv::Mat I = MakeImage(0.0f, 0.0f, 320, 240);
+
+  for (int sub_sampling : {1, 2, 3}) {
+    const cv::Rect roi(60, 40, 151, 122);
+    Sampler sampler(sub_sampling);
+
+    // 1.normalization: centroid and mean distance of the sampled points
+    Matrix33f T, T_inv;
+    sampler.getNormedCoordinate(roi, T, T_inv);
+    Vector2f c(0, 0);
+    int n = 0;
+    for (int y = 1; y < roi.height - 1; y += sub_sampling)
+      for (int x = 1; x < roi.width - 1; x += sub_sampling, ++n)
+        c += Vector2f(x + roi.x, y + roi.y);
+    c /= n;
+    float m = 0.0f;
+    for (int y = 1; y < roi.height - 1; y += sub_sampling)
+      for (int x = 1; x < roi.width - 1; x += sub_sampling)
+        m += (Vector2f(x + roi.x, y + roi.y) - c).norm();
+    m /= n;
+    CHECK(n == sampler.NumPixels(roi));
+    CHECK((T_inv.col(2).head<2>() - c).norm() < 1e-3f);
+    CHECK(std::fabs(T(0, 0) * m / std::sqrt(2.0f) - 1.0f) < 1e-2f);
+    CHECK((T * T_inv - Matrix33f::Identity()).norm() < 1e-5f);
+
+    // 2.jacobians against the per-channel definition
+    Arena arena;
+    arena.reserve(sampler.BufferSize(roi) + 2 * Arena::Bytes<float>(8 * n));
+    Timer timer;
+    sampler.set(I, roi, arena, T(0, 0), T_inv(0, 2), T_inv(1, 2));
+    const auto time_ms = timer.stop().count();
+
+    cv::Mat lbp;
+    simd::LBP(I, roi, lbp);
+    const auto &J = sampler.jacobian();
+    float err = 0.0f;
+    for (int y = 1, i = 0, j = 0; y < lbp.rows - 1; y += sub_sampling) {
+      for (int x = 1; x < lbp.cols - 1; x += sub_sampling, i += 8, ++j) {
+        const auto Jw = Homography::ComputeWarpJacobian(x + roi.x, y + roi.y, T(0, 0), T_inv(0, 2), T_inv(1, 2));
+        CHECK(sampler.pixels()[j] == lbp.at<uint8_t>(y, x));
+        for (int b = 0; b < 8; ++b) {
+          auto bit = [&](int xx, int yy) { return static_cast<float>((lbp.at<uint8_t>(yy, xx) >> b) & 1); };
+          const Eigen::Matrix<float, 1, 2> g(0.5f * (bit(x + 1, y) - bit(x - 1, y)), 0.5f * (bit(x, y + 1) - bit(x, y - 1)));
+          err = std::max(err, (J.row(i + b) - g * Jw).cwiseAbs().maxCoeff());
+        }
+      }
+    }
+    CHECK(err < 1e-5f);
+
+    // 3.hessian accumulated with the jacobians
+    const Homography::Hessian H = J.transpose() * J;
+    CHECK((sampler.hessian() - H).norm() < 1e-4f * H.norm());
+
+    // 4.fused residuals and gradient against the separate computation
+    const cv::Mat Iw = I(roi + cv::Point(2, 1)).clone();
+    Sampler::Residuals r0(arena.allocate<float>(8 * n), 8 * n), r1(arena.allocate<float>(8 * n), 8 * n);
+    sampler.ComputeResiduals(Iw, r0);
+    const Homography::Gradient g0 = J.transpose() * r0;
+    Homography::Gradient g1;
+    const float sum_sq = sampler.ComputeResidualsAndGradient(Iw, r1, g1);
+    CHECK(r0 == r1);
+    CHECK((g1 - g0).norm() < 1e-4f * std::max(1.0f, g0.norm()));
+    CHECK(std::fabs(sum_sq - r0.squaredNorm()) < 1e-3f);
+
+    std::cout << "sub_sampling " << sub_sampling << ": " << n << " pixels, " << time_ms << " ms" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/01 09:30
+ * @Description: Stress test of independent trackers used from many threads,
+ * meant to run under ThreadSanitizer (cmake -DENABLE_TSAN=ON)
+ * @FilePath: Bitplanes/test/TestConcurrency.cc
+ */
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace NAMESPACE;
+
+typedef PyramidTracker<Homography> TrackerType;
+
+/**
+ * the sequence run by each tracker: set, track, update and replace the
+ * template. Returns the last pose
+ */
+static Matrix33f Run(TrackerType &tracker, const std::vector<cv::Mat> &frames, int k) {
+  const cv::Rect bbox(80 + 4 * (k % 8), 60 + 3 * (k % 5), 100, 90);
+  tracker.setTemplate(frames[0], bbox);
+
+  Matrix33f T = Matrix33f::Identity();
+  for (size_t i = 1; i < frames.size(); ++i) {
+    T = tracker.Track(frames[i], T).T;
+    if (i == frames.size() / 2) {
+      tracker.updateTemplate(frames[0], cv::Rect(bbox.x, bbox.y, bbox.width / 2, bbox.height / 2));
+      tracker.setTemplateAsync(frames[0], bbox);
+      tracker.waitForTemplate();
+      T.setIdentity();
+    }
+  }
+  return T;
+}
+
+int main() {
+  const int num_trackers = 16, num_frames = 12;
+
+  std::vector<cv::Mat> frames;
+  for (int i = 0; i < num_frames; ++i)
+    frames.push_back(MakeImage(0.5f * i, 0.25f * i));
+
+  Parameters params;
+  params.num_levels = 3;
+  params.verbose = false;
+  params.search_margin = 0.5f;
+  params.motion_predictor = Parameters::MotionPredictorType::ConstantVelocity;
+
+  // 1.reference poses, one tracker at a time
+  std::vector<Matrix33f, Eigen::aligned_allocator<Matrix33f>> expected(num_trackers), actual(num_trackers);
+  for (int k = 0; k < num_trackers; ++k) {
+    TrackerType tracker(params);
+    expected[k] = Run(tracker, frames, k);
+  }
+
+  // 2.the same sequences, all trackers at once, sharing the frames
+  std::vector<std::unique_ptr<TrackerType>> trackers;
+  for (int k = 0; k < num_trackers; ++k)
+    trackers.emplace_back(new TrackerType(params));
+
+  std::atomic<bool> go{false};
+  std::vector<std::thread> threads;
+  for (int k = 0; k < num_trackers; ++k) {
+    threads.emplace_back([&, k]() {
+      while (!go) std::this_thread::yield();
+      actual[k] = Run(*trackers[k], frames, k);
+    });
+  }
+  go = true;
+  for (auto &t : threads)
+    t.join();
+
+  // 3.concurrency does not change the results
+  int num_failed = 0;
+  for (int k = 0; k < num_trackers; ++k) {
+    if ((actual[k] - expected[k]).norm() > 1e-5f) {
+      std::cout << "tracker " << k << " differs:\n" << actual[k] << "\n" << expected[k] << std::endl;
+      ++num_failed;
+    }
+  }
+  std::cout << num_trackers << " trackers, " << num_failed << " failed" << std::endl;
+  return num_failed == 0 ? 0 : 1;
+}
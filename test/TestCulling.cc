@@ -0,0 +1,159 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/08 16:00
+ * @Description: Test of the culling of the template pixels warped from
+ * outside the image
+ * @FilePath: Bitplanes/test/TestCulling.cc
+ */
+#include "ChannelDataSampler.h"
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace NAMESPACE;
+
+typedef ChannelDataSampler<Homography> Sampler;
+
+/**
+ * the hidden pixels have no residuals and no part in the gradient, and their
+ * hessians complete the one of the visible pixels
+ */
+static int TestSampler(const cv::Mat &I) {
+  const cv::Rect roi(200, 40, 101, 122);
+  const Matrix33f T = Translation(27.5f, -50.25f);
+  for (int sub_sampling : {1, 2}) {
+    for (int tile_size : {0, 16}) {
+      Sampler sampler(sub_sampling);
+      sampler.setTileSize(tile_size);
+      Matrix33f N, N_inv;
+      sampler.getNormedCoordinate(roi, N, N_inv);
+      const int n = sampler.NumPixels(roi);
+      Arena arena;
+      arena.reserve(sampler.BufferSize(roi) + 2 * Arena::Bytes<float>(8 * n));
+      sampler.set(I, roi, arena, N(0, 0), N_inv(0, 2), N_inv(1, 2));
+
+      // 1.the template leaves the image on the right and at the top
+      cv::Mat Iw;
+      std::vector<int> bounds(2 * roi.height), cols(2 * sampler.gridRows());
+      CHECK(!sampler.WarpImage(I, T, roi, Iw, cv::INTER_LINEAR, 0.0f, bounds.data()));
+      const int m = sampler.VisibleColumns(bounds.data(), cols.data());
+      CHECK(m > 0 && m < n);
+
+      // 2.the visible pixels have all of their LBP neighborhood in the image
+      Sampler::Residuals r_all(arena.allocate<float>(8 * n), 8 * n), r(arena.allocate<float>(8 * n), 8 * n);
+      sampler.ComputeResiduals(Iw, r_all);
+      Homography::Gradient g;
+      const float sum_sq = sampler.ComputeResidualsAndGradient(Iw, r, g, cols.data());
+      Homography::Hessian H_visible = Homography::Hessian::Zero();
+      Homography::Gradient g_expected = Homography::Gradient::Zero();
+      const int ss = sub_sampling;
+      int j = 0, num_visible = 0;
+      for (int y = 1; y < roi.height - 1; y += ss) {
+        for (int x = 1; x < roi.width - 1; x += ss, ++j) {
+          bool visible = true;
+          for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+              const Eigen::Vector3f p = T * Eigen::Vector3f(static_cast<float>(roi.x + x + dx),
+                                                            static_cast<float>(roi.y + y + dy), 1.0f);
+              visible = visible && p[0] >= 0.0f && p[1] >= 0.0f && p[0] < I.cols - 1 && p[1] < I.rows - 1;
+            }
+          }
+          if (!visible) {
+            CHECK(r.segment(8 * j, 8).isZero());
+            continue;
+          }
+          ++num_visible;
+          CHECK(r.segment(8 * j, 8) == r_all.segment(8 * j, 8));
+          const auto J = sampler.jacobian().middleRows(8 * j, 8);
+          H_visible += J.transpose() * J;
+          g_expected += J.transpose() * r.segment(8 * j, 8);
+        }
+      }
+      CHECK(num_visible == m);
+      CHECK((g - g_expected).norm() < 1e-4f * std::max(1.0f, g.norm()));
+      CHECK(std::fabs(sum_sq - r.squaredNorm()) < 1e-3f);
+
+      // 3.the same with tiles
+      EigenStdVector<Homography::Gradient>::type tile_g(sampler.numTiles());
+      std::vector<float> tile_sum_sq(sampler.numTiles());
+      sampler.ComputeTileResidualsAndGradients(Iw, r_all, tile_g.data(), tile_sum_sq.data(), cols.data());
+      CHECK(r_all == r);
+      Homography::Gradient g_tiles = Homography::Gradient::Zero();
+      for (const auto &gt : tile_g)
+        g_tiles += gt;
+      CHECK((g_tiles - g).norm() < 1e-4f * std::max(1.0f, g.norm()));
+
+      // 4.hidden and visible hessians add up to the whole one
+      EigenStdVector<Homography::Hessian>::type hidden(sampler.numTiles());
+      std::vector<int> hidden_pixels(sampler.numTiles());
+      sampler.HiddenHessians(cols.data(), hidden.data(), hidden_pixels.data());
+      Homography::Hessian H = H_visible;
+      int num_hidden = 0;
+      for (int t = 0; t < sampler.numTiles(); ++t) {
+        H += hidden[t];
+        num_hidden += hidden_pixels[t];
+      }
+      CHECK(num_hidden == n - m);
+      CHECK((H - sampler.hessian()).norm() < 1e-3f * H.norm());
+
+      // 5.nothing is hidden when the template is inside the image
+      CHECK(sampler.WarpImage(I, Translation(-20.0f, 3.0f), roi, Iw, cv::INTER_LINEAR, 0.0f, bounds.data()));
+      CHECK(sampler.VisibleColumns(bounds.data(), cols.data()) == n);
+    }
+  }
+  return 0;
+}
+
+/**
+ * a target partly out of the frame is tracked as in a larger frame where it
+ * is all visible
+ */
+static int TestTracking(const cv::Mat &I0) {
+  const cv::Rect bbox(200, 80, 100, 90);
+  const float tx = 32.0f, ty = 2.0f;
+  const cv::Mat clipped = MakeImage(tx, ty), wide = MakeImage(tx, ty, 400);
+
+  for (int tile_size : {0, 16}) {
+    Parameters params;
+    params.num_levels = 1;
+    params.verbose = false;
+    params.tile_size = tile_size;
+    Tracker<Homography> tracker(params);
+    tracker.setTemplate(I0, bbox);
+
+    const Matrix33f T_init = Translation(tx - 1.0f, ty + 0.5f);
+    const Result r_wide = tracker.Track(wide, T_init);
+    const Result r_clipped = tracker.Track(clipped, T_init);
+    const float e = (r_clipped.T.col(2) - r_wide.T.col(2)).norm();
+    std::cout << "tile size " << tile_size << ": visible " << r_clipped.visible_fraction << ", error " << e
+              << ", " << r_clipped.num_iterations << " iterations" << std::endl;
+    CHECK(r_wide.visible_fraction == 1.0f);
+    CHECK(r_clipped.visible_fraction > 0.75f && r_clipped.visible_fraction < 0.9f);
+    CHECK(r_clipped.dropped_tiles == 0);
+    CHECK(r_clipped.status != OptimizerStatus::MaxIterations);
+    CHECK(e < 1.0f);
+
+    // a template all outside the frame is lost
+    const Result r_out = tracker.Track(clipped, Translation(200.0f, 0.0f));
+    CHECK(r_out.visible_fraction == 0.0f);
+    CHECK(!r_out.successful);
+
+    // and all of it is used again once it is back
+    CHECK(tracker.Track(wide, T_init).T == r_wide.T);
+  }
+  return 0;
+}
+
+int main() {
+  const cv::Mat I = MakeImage(0.0f, 0.0f);
+  if (TestSampler(I) || TestTracking(I))
+    return 1;
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
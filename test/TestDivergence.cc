@@ -0,0 +1,139 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/15 14:40
+ * @Description: Test of the divergence detection, Parameters::abort_on_divergence
+ * @FilePath: Bitplanes/test/TestDivergence.cc
+ */
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+using namespace NAMESPACE;
+
+/**
+ * gives access to the cost of a pose in the frame of the last Track
+ */
+class ProbeTracker : public Tracker<Homography> {
+public:
+  explicit ProbeTracker(const Parameters &p) : Tracker<Homography>(p) {}
+
+  float cost(const Transform &T) {
+    this->Linearize(this->I_, T);
+    return this->Cost();
+  }
+};
+
+/**
+ * frame where the target is gone: white noise
+ */
+static cv::Mat MakeNoise(uint32_t seed) {
+  cv::Mat I(240, 320, CV_8UC1);
+  uint32_t s = seed;
+  for (int y = 0; y < I.rows; ++y) {
+    for (int x = 0; x < I.cols; ++x) {
+      s = s * 1664525u + 1013904223u;
+      I.at<uint8_t>(y, x) = static_cast<uint8_t>(s >> 24);
+    }
+  }
+  return I;
+}
+
+/**
+ * tracks the noise frame from the template pose, the frame is seen by probe
+ * afterwards
+ */
+static Result TrackNoise(const Parameters &params, std::unique_ptr<ProbeTracker> &probe, const cv::Mat &I0,
+                         const cv::Mat &noise, const cv::Rect &bbox) {
+  probe.reset(new ProbeTracker(params));
+  probe->setTemplate(I0, bbox);
+  return probe->Track(noise, Matrix33f::Identity());
+}
+
+int main() {
+  const cv::Rect bbox(100, 80, 100, 90);
+  const cv::Mat I0 = MakeImage(0.0f, 0.0f), noise = MakeNoise(7);
+
+  Parameters params;
+  params.max_iterations = 50;
+  params.verbose = false;
+  params.abort_on_divergence = true;
+  std::unique_ptr<ProbeTracker> probe;
+
+  // 1.a step larger than max_step_norm aborts the optimization
+  params.max_cost_increases = 0;
+  params.max_step_norm = 1e-3f;
+  Result r = TrackNoise(params, probe, I0, noise, bbox);
+  CHECK(r.status == OptimizerStatus::Diverged && !r.successful);
+  CHECK(r.num_iterations < params.max_iterations);
+
+  // 2.so do consecutive cost increases
+  params.max_cost_increases = 1;
+  params.max_step_norm = 0.0f;
+  r = TrackNoise(params, probe, I0, noise, bbox);
+  CHECK(r.status == OptimizerStatus::Diverged && !r.successful);
+  CHECK(r.num_iterations < params.max_iterations);
+
+  // 3.with the default thresholds, the lost target is detected as well
+  params.max_cost_increases = Parameters().max_cost_increases;
+  params.max_step_norm = Parameters().max_step_norm;
+  r = TrackNoise(params, probe, I0, noise, bbox);
+  std::cout << "default thresholds: " << ToString(r.status) << " after " << r.num_iterations << " iterations"
+            << std::endl;
+  CHECK(r.status == OptimizerStatus::Diverged && r.num_iterations < params.max_iterations);
+
+  // 4.revert_to_best returns the lowest cost pose the optimization went
+  // through, found again by stopping the same optimization after each
+  // iteration without divergence detection
+  params.max_cost_increases = 1;
+  params.max_step_norm = 0.0f;
+  params.revert_to_best = true;
+  const Result best = TrackNoise(params, probe, I0, noise, bbox);
+  CHECK(best.status == OptimizerStatus::Diverged);
+  const float best_cost = probe->cost(best.T);
+
+  Parameters unchecked = params;
+  unchecked.abort_on_divergence = false;
+  float min_cost = std::numeric_limits<float>::max();
+  for (int k = 1; k < best.num_iterations; ++k) {
+    unchecked.max_iterations = k;
+    const Result step = TrackNoise(unchecked, probe, I0, noise, bbox);
+    min_cost = std::min(min_cost, probe->cost(step.T));
+  }
+  std::cout << "best cost " << best_cost << ", lowest cost on the way " << min_cost << std::endl;
+  CHECK(best_cost <= min_cost * (1.0f + 1e-5f));
+
+  // 4.1 without it the last pose comes back, which costs more
+  params.revert_to_best = false;
+  const Result last = TrackNoise(params, probe, I0, noise, bbox);
+  CHECK(last.status == OptimizerStatus::Diverged);
+  CHECK(probe->cost(last.T) > best_cost);
+
+  // 5.the pyramid skips the finer levels of a diverged frame
+  params.num_levels = 3;
+  params.max_cost_increases = 0;
+  params.max_step_norm = 1e-3f;
+  PyramidTracker<Homography> pyramid(params);
+  pyramid.setTemplate(I0, bbox);
+  r = pyramid.Track(noise, Matrix33f::Identity());
+  CHECK(r.status == OptimizerStatus::Diverged && !r.successful);
+  CHECK(r.level == params.num_levels - 1 && r.num_levels == 1);
+
+  // 5.1 a frame where the target is still visible is tracked as usual
+  params.max_cost_increases = Parameters().max_cost_increases;
+  params.max_step_norm = Parameters().max_step_norm;
+  PyramidTracker<Homography> tracked(params);
+  tracked.setTemplate(I0, bbox);
+  r = tracked.Track(MakeImage(2.0f, 1.0f), Matrix33f::Identity());
+  CHECK(r.status != OptimizerStatus::Diverged && r.successful && r.level == 0);
+
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/14 11:00
+ * @Description: Test of FramePool, alone and between a capture thread and
+ * PipelinedTracker
+ * @FilePath: Bitplanes/test/TestFramePool.cc
+ */
+#include "FramePool.h"
+#include "Filter.h"
+#include "MotionModel.h"
+#include "PipelinedTracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace NAMESPACE;
+
+typedef PipelinedTracker<Homography> PipelineType;
+typedef PyramidTracker<Homography> TrackerType;
+
+/**
+ * the buffers are preallocated, reused, and acquire waits for one when they
+ * are all in use
+ */
+static int TestRecycle() {
+  const cv::Size size(320, 240);
+  FramePool pool(3, size, CV_8UC1);
+  CHECK(pool.numBuffers() == 3 && pool.available() == 3);
+
+  // 1.the buffers have the size and type of the frames
+  std::vector<cv::Mat> bufs(3);
+  std::set<const uint8_t *> data;
+  for (auto &b : bufs) {
+    CHECK(pool.acquire(&b));
+    CHECK(b.size() == size && b.type() == CV_8UC1);
+    data.insert(b.data);
+  }
+  CHECK(data.size() == 3 && pool.available() == 0);
+
+  // 2.an exhausted pool gives nothing once the wait time is over
+  cv::Mat extra;
+  CHECK(!pool.acquire(&extra, 1));
+  CHECK(pool.stats().exhausted == 1 && pool.stats().acquired == 3);
+
+  // 3.writing a frame of the same size into a released buffer keeps its memory
+  const cv::Mat frame = MakeImage(1.0f, 2.0f);
+  for (int i = 0; i < 10; ++i) {
+    for (auto &b : bufs)
+      pool.release(std::move(b));
+    for (auto &b : bufs) {
+      CHECK(pool.acquire(&b));
+      frame.copyTo(b);
+      CHECK(data.count(b.data) == 1);
+    }
+  }
+
+  // 4.a buffer released by another thread ends the wait
+  std::thread consumer([&bufs, &pool]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    pool.release(std::move(bufs[0]));
+  });
+  CHECK(pool.acquire(&extra, 5000));
+  consumer.join();
+  CHECK(data.count(extra.data) == 1);
+  const FramePool::Stats stats = pool.stats();
+  CHECK(stats.exhausted == 2 && stats.acquired == 34);
+  CHECK(stats.wait_ms > 0.0f);
+  return 0;
+}
+
+/**
+ * a capture thread fills the pooled buffers and pushes them to the pipeline,
+ * the consumer releases them after popping: the results are the ones of the
+ * serial tracker and the frames never leave the pool
+ */
+static int TestCapture(const Parameters &params, const cv::Mat &I0, const cv::Rect &bbox,
+                       const std::vector<cv::Mat> &frames) {
+  const std::vector<Result> expected = TrackSerial(params, I0, bbox, frames);
+
+  const int depth = 2;
+  PipelineType pipeline(params, depth);
+  pipeline.setTemplate(I0, bbox);
+  FramePool pool(depth + 2, I0.size(), I0.type());
+
+  std::set<const uint8_t *> data;
+  {
+    std::vector<cv::Mat> bufs(pool.numBuffers());
+    for (auto &b : bufs) {
+      CHECK(pool.acquire(&b));
+      data.insert(b.data);
+    }
+    for (auto &b : bufs)
+      pool.release(std::move(b));
+  }
+
+  std::thread capture([&pipeline, &pool, &frames]() {
+    for (size_t i = 0; i < frames.size(); ++i) {
+      cv::Mat image;
+      while (!pool.acquire(&image)) {}
+      frames[i].copyTo(image);
+      pipeline.push(image, static_cast<double>(i + 1));
+    }
+  });
+
+  bool ok = true;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    PipelineType::FrameResult r;
+    while (!pipeline.pop(r))
+      std::this_thread::yield();
+    ok = ok && r.frame == static_cast<int64_t>(i);
+    ok = ok && data.count(r.image.data) == 1;
+    ok = ok && r.result.T == expected[i].T;
+    pool.release(std::move(r.image));
+  }
+  capture.join();
+  CHECK(ok);
+  CHECK(pool.available() == pool.numBuffers());
+  CHECK(pool.stats().acquired == static_cast<int64_t>(frames.size() + pool.numBuffers()));
+  return 0;
+}
+
+int main() {
+  Parameters params;
+  params.num_levels = 3;
+  params.verbose = false;
+  const cv::Mat I0 = MakeImage(0.0f, 0.0f);
+  const cv::Rect bbox(100, 80, 100, 90);
+  std::vector<cv::Mat> frames;
+  for (int i = 1; i <= 12; ++i)
+    frames.push_back(MakeImage(0.7f * i, 0.3f * i));
+
+  if (TestRecycle() || TestCapture(params, I0, bbox, frames))
+    return 1;
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
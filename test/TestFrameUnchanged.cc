@@ -0,0 +1,84 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/15 15:50
+ * @Description: Test of the detection of unchanged frames,
+ * Parameters::unchanged_frame_threshold
+ * @FilePath: Bitplanes/test/TestFrameUnchanged.cc
+ */
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <iostream>
+
+using namespace NAMESPACE;
+
+typedef PyramidTracker<Homography> TrackerType;
+
+/**
+ * a repeated frame returns the previous result without iterating, unless the
+ * caller gives another initial pose
+ */
+static int TestRepeated(const Parameters &params, const cv::Rect &bbox) {
+  TrackerType tracker(params);
+  tracker.setTemplate(MakeImage(0.0f, 0.0f), bbox);
+  const cv::Mat I1 = MakeImage(2.0f, 1.0f);
+
+  // 1.the first frame is tracked
+  const Result first = tracker.Track(I1);
+  CHECK(first.status != OptimizerStatus::FrameUnchanged && first.num_iterations > 0);
+
+  // 2.the same frame again comes back right away with the same pose
+  Result r = tracker.Track(I1);
+  CHECK(r.status == OptimizerStatus::FrameUnchanged);
+  CHECK(r.num_iterations == 0 && r.num_levels == 0);
+  CHECK(r.T == first.T);
+
+  // 2.1 so does it when the caller passes the previous pose
+  r = tracker.Track(I1, first.T);
+  CHECK(r.status == OptimizerStatus::FrameUnchanged && r.num_iterations == 0);
+
+  // 3.another initial pose is tracked even though the frame did not change
+  const Matrix33f T = Translation(6.0f, -4.0f);
+  r = tracker.Track(I1, T);
+  CHECK(r.status != OptimizerStatus::FrameUnchanged);
+  CHECK(r.num_iterations > 0 && r.num_levels == params.num_levels);
+  CHECK(r.successful && !r.T.isApprox(T));
+
+  // 4.a frame that changed is tracked
+  r = tracker.Track(MakeImage(5.0f, 2.0f));
+  CHECK(r.status != OptimizerStatus::FrameUnchanged && r.num_iterations > 0);
+  return 0;
+}
+
+/**
+ * the pose predicted by the motion model is the tracker's own, a static scene
+ * after a motion is detected as well
+ */
+static int TestPredicted(Parameters params, const cv::Rect &bbox) {
+  params.motion_predictor = Parameters::MotionPredictorType::ConstantVelocity;
+  TrackerType tracker(params);
+  tracker.setTemplate(MakeImage(0.0f, 0.0f), bbox);
+  for (int k = 1; k <= 3; ++k)
+    CHECK(tracker.Track(MakeImage(1.0f * k, 0.5f * k), static_cast<double>(k)).successful);
+
+  const Result r = tracker.Track(MakeImage(3.0f, 1.5f), 4.0);
+  CHECK(r.status == OptimizerStatus::FrameUnchanged && r.num_iterations == 0);
+  return 0;
+}
+
+int main() {
+  Parameters params;
+  params.num_levels = 3;
+  params.max_iterations = 50;
+  params.verbose = false;
+  params.unchanged_frame_threshold = 1.0f;
+  const cv::Rect bbox(100, 80, 100, 90);
+
+  if (TestRepeated(params, bbox) || TestPredicted(params, bbox))
+    return 1;
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/07 11:10
+ * @Description: Test of templates of arbitrary shape: masks and sets of
+ * rectangles
+ * @FilePath: Bitplanes/test/TestMask.cc
+ */
+#include "ChannelDataSampler.h"
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace NAMESPACE;
+
+typedef ChannelDataSampler<Homography> Sampler;
+
+/**
+ * a disk in the box of the given size
+ */
+static cv::Mat MakeDisk(const cv::Size &size) {
+  cv::Mat mask(size, CV_8UC1);
+  const float cx = 0.5f * static_cast<float>(size.width), cy = 0.5f * static_cast<float>(size.height);
+  const float r = 0.45f * static_cast<float>(std::min(size.width, size.height));
+  for (int y = 0; y < size.height; ++y)
+    for (int x = 0; x < size.width; ++x)
+      mask.at<uint8_t>(y, x) = std::hypot(static_cast<float>(x) - cx, static_cast<float>(y) - cy) < r ? 255 : 0;
+  return mask;
+}
+
+/**
+ * the masked template holds the pixels of the full template inside the mask,
+ * with the same jacobians and residuals
+ */
+static int TestSampler(const cv::Mat &I) {
+  const cv::Rect roi(60, 40, 151, 122);
+  const cv::Mat Iw = I(roi + cv::Point(2, 1)).clone();
+  const cv::Mat disk = MakeDisk(roi.size());
+  for (int sub_sampling : {1, 2}) {
+    for (int tile_size : {0, 16}) {
+      Sampler full(sub_sampling), masked(sub_sampling);
+      full.setTileSize(tile_size);
+      masked.setTileSize(tile_size);
+      Matrix33f T, T_inv;
+      full.getNormedCoordinate(roi, T, T_inv);
+
+      const int n = full.NumPixels(roi), m = masked.NumPixels(roi, disk);
+      CHECK(m > 0 && m < n);
+      Arena arena;
+      arena.reserve(full.BufferSize(roi) + masked.BufferSize(roi, disk) + Arena::Bytes<float>(8 * n) +
+                    Arena::Bytes<float>(8 * m));
+      full.set(I, roi, arena, T(0, 0), T_inv(0, 2), T_inv(1, 2));
+      masked.set(I, roi, arena, T(0, 0), T_inv(0, 2), T_inv(1, 2), disk);
+      CHECK(masked.pixels().size() == m);
+
+      // 1.a full mask gives the same template
+      {
+        Sampler all(sub_sampling);
+        Arena a;
+        cv::Mat ones(roi.size(), CV_8UC1);
+        ones.setTo(255);
+        a.reserve(all.BufferSize(roi, ones));
+        all.set(I, roi, a, T(0, 0), T_inv(0, 2), T_inv(1, 2), ones);
+        CHECK(all.pixels() == full.pixels());
+        CHECK(all.jacobian() == full.jacobian());
+      }
+
+      // 2.the pixels, jacobians and residuals inside the mask, in the same order
+      Sampler::Residuals r_full(arena.allocate<float>(8 * n), 8 * n), r_masked(arena.allocate<float>(8 * m), 8 * m);
+      full.ComputeResiduals(Iw, r_full);
+      Homography::Gradient g;
+      masked.ComputeResidualsAndGradient(Iw, r_masked, g);
+      Homography::Hessian H = Homography::Hessian::Zero();
+      Homography::Gradient g_expected = Homography::Gradient::Zero();
+      const int ss = sub_sampling;
+      int i = 0, j = 0;
+      for (int y = 1; y < roi.height - 1; y += ss) {
+        for (int x = 1; x < roi.width - 1; x += ss, ++j) {
+          if (!disk.at<uint8_t>(y, x))
+            continue;
+          CHECK(masked.pixels()[i] == full.pixels()[j]);
+          CHECK(masked.jacobian().middleRows(8 * i, 8) == full.jacobian().middleRows(8 * j, 8));
+          CHECK(r_masked.segment(8 * i, 8) == r_full.segment(8 * j, 8));
+          const auto J = full.jacobian().middleRows(8 * j, 8);
+          H += J.transpose() * J;
+          g_expected += J.transpose() * r_full.segment(8 * j, 8);
+          ++i;
+        }
+      }
+      CHECK(i == m);
+      CHECK((H - masked.hessian()).norm() < 1e-4f * H.norm());
+      CHECK((g - g_expected).norm() < 1e-4f * std::max(1.0f, g.norm()));
+
+      // 3.the tiles add up to the masked template
+      Homography::Hessian H_tiles = Homography::Hessian::Zero();
+      int num_pixels = 0;
+      for (int t = 0; t < masked.numTiles(); ++t) {
+        H_tiles += masked.tileHessian(t);
+        num_pixels += masked.tilePixels(t);
+      }
+      CHECK(num_pixels == m);
+      CHECK((H_tiles - masked.hessian()).norm() < 1e-4f * H.norm());
+
+      // 4.an update only touches the pixels inside the mask
+      const cv::Mat I1 = MakeImage(1.0f, 0.0f);
+      const int n_updated = masked.update(I1, cv::Point(0, 0), roi);
+      CHECK(n_updated == m);
+      Sampler reference(sub_sampling);
+      Arena a;
+      a.reserve(reference.BufferSize(roi, disk));
+      reference.set(I1, roi, a, T(0, 0), T_inv(0, 2), T_inv(1, 2), disk);
+      CHECK(reference.pixels() == masked.pixels());
+      CHECK((reference.hessian() - masked.hessian()).norm() < 1e-3f * reference.hessian().norm());
+    }
+  }
+  return 0;
+}
+
+/**
+ * a background that moves differently is left out of the template by the mask
+ */
+static int TestTracking(const cv::Mat &I0) {
+  const cv::Rect bbox(100, 80, 100, 90);
+  const cv::Mat clean = MakeImage(3.0f, 2.0f);
+  cv::Mat I1 = clean.clone();
+
+  // 1.the right part of the box is background, replaced in the new frame
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> dist(0, 255);
+  for (int y = bbox.y - 10; y < bbox.y + bbox.height + 10; ++y)
+    for (int x = bbox.x + 60; x < bbox.x + bbox.width + 10; ++x)
+      I1.at<uint8_t>(y, x) = static_cast<uint8_t>(dist(rng));
+  cv::Mat mask = cv::Mat::zeros(bbox.size(), CV_8UC1);
+  mask(cv::Rect(0, 0, 50, bbox.height)).setTo(255);
+
+  Parameters params;
+  params.num_levels = 1;
+  params.verbose = false;
+  Tracker<Homography> whole(params), masked(params);
+  whole.setTemplate(I0, bbox);
+  masked.setTemplate(I0, bbox, mask);
+  const Result r_whole = whole.Track(I1), r_whole_clean = whole.Track(clean);
+  const Result r_masked = masked.Track(I1), r_masked_clean = masked.Track(clean);
+
+  const float e_whole = (r_whole.T - r_whole_clean.T).norm(), e_masked = (r_masked.T - r_masked_clean.T).norm();
+  std::cout << "whole: error " << e_whole << ", masked: error " << e_masked << std::endl;
+  CHECK(e_masked < 0.05f);
+  CHECK(e_masked < e_whole);
+
+  // 2.a set of rectangles is the same as the mask of their union
+  params.num_levels = 3;
+  const std::vector<cv::Rect> rects = {cv::Rect(100, 80, 40, 90), cv::Rect(150, 80, 50, 40)};
+  cv::Mat union_mask = cv::Mat::zeros(bbox.size(), CV_8UC1);
+  union_mask(cv::Rect(0, 0, 40, 90)).setTo(255);
+  union_mask(cv::Rect(50, 0, 50, 40)).setTo(255);
+  PyramidTracker<Homography> a(params), b(params);
+  a.setTemplate(I0, rects);
+  b.setTemplate(I0, bbox, union_mask);
+  for (int i = 1; i < 4; ++i) {
+    const cv::Mat I = MakeImage(0.5f * i, 0.25f * i);
+    CHECK((a.Track(I).T - b.Track(I).T).norm() < 1e-6f);
+  }
+
+  // 2.1 overlapping rectangles are merged into their union
+  const std::vector<cv::Rect> overlapping = {cv::Rect(100, 80, 40, 90), cv::Rect(100, 80, 40, 50),
+                                             cv::Rect(150, 80, 50, 40), cv::Rect(170, 90, 30, 30)};
+  PyramidTracker<Homography> c(params), d(params);
+  c.setTemplate(I0, overlapping);
+  d.setTemplate(I0, bbox, union_mask);
+  for (int i = 1; i < 4; ++i) {
+    const cv::Mat I = MakeImage(0.5f * i, 0.25f * i);
+    CHECK((c.Track(I).T - d.Track(I).T).norm() < 1e-6f);
+  }
+  return 0;
+}
+
+int main() {
+  const cv::Mat I = MakeImage(0.0f, 0.0f);
+  if (TestSampler(I) || TestTracking(I))
+    return 1;
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/15 11:05
+ * @Description: Test of the motion predictors: extrapolation of a constant
+ * velocity sequence, filtering and reset
+ * @FilePath: Bitplanes/test/TestMotionPredictor.cc
+ */
+#include "MotionModel.h"
+#include "MotionPredictor.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <Eigen/LU>
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace NAMESPACE;
+
+typedef MotionPredictor<Homography> PredictorType;
+typedef PyramidTracker<Homography> TrackerType;
+
+static const cv::Rect kBox(100, 80, 100, 90);
+
+/**
+ * relative motion of each frame: rotation, scale, translation and a bit of
+ * perspective
+ */
+static Matrix33f Step() {
+  const float a = 0.01f, s = 1.005f;
+  Matrix33f A;
+  A << s * std::cos(a), -s * std::sin(a), 2.5f,
+       s * std::sin(a), s * std::cos(a), -1.5f,
+       2e-5f, -1e-5f, 1.0f;
+  return A;
+}
+
+/**
+ * the pose of a constant velocity sequence is extrapolated exactly, also
+ * between frames and with timestamps that are not one time unit apart
+ */
+static int TestExtrapolation(PredictorType &predictor) {
+  const Matrix33f A = Step();
+  const double t0 = 0.5, dt = 0.1;
+
+  // 1.before two poses the prediction is the last pose
+  predictor.reset();
+  CHECK(predictor.predict(t0).isApprox(Matrix33f::Identity()));
+  predictor.update(A, t0);
+  CHECK(CornerError(kBox, predictor.predict(t0 + dt), A) < 1e-4f);
+
+  // 2.T_k = A^k at t0 + (k - 1) dt
+  Matrix33f T = A;
+  for (int k = 2; k <= 6; ++k) {
+    T = A * T;
+    predictor.update(T, t0 + (k - 1) * dt);
+  }
+  CHECK(CornerError(kBox, predictor.predict(t0 + 6 * dt), A * T) < 1e-2f);
+  CHECK(CornerError(kBox, predictor.predict(t0 + 7 * dt), A * A * T) < 1e-2f);
+
+  // 3.half a step is the square root of the step
+  const Matrix33f half = predictor.predict(t0 + 5.5 * dt);
+  CHECK(CornerError(kBox, half * T.inverse() * half * T.inverse(), A) < 1e-2f);
+
+  // 4.reset forgets the history
+  predictor.reset();
+  CHECK(predictor.predict(t0 + 6 * dt).isApprox(Matrix33f::Identity()));
+  return 0;
+}
+
+/**
+ * mean prediction error on a constant velocity sequence with a jitter of
+ * alternating sign
+ */
+static float JitteredError(PredictorType &predictor) {
+  const Matrix33f A = Step();
+  predictor.reset();
+  Matrix33f T = Matrix33f::Identity();
+  float sum = 0.0f;
+  int n = 0;
+  for (int k = 1; k <= 40; ++k) {
+    T = A * T;
+    const float j = (k % 2) ? 0.5f : -0.5f;
+    const Matrix33f measured = Translation(j, -j) * T;
+    if (k > 10) {
+      sum += CornerError(kBox, predictor.predict(static_cast<double>(k)), T);
+      ++n;
+    }
+    predictor.update(measured, static_cast<double>(k));
+  }
+  return sum / static_cast<float>(n);
+}
+
+/**
+ * the predictor of PyramidTracker follows the tracked poses and is reset by a
+ * new template
+ */
+static int TestTracker(Parameters::MotionPredictorType type) {
+  Parameters params;
+  params.num_levels = 3;
+  params.max_iterations = 50;
+  params.verbose = false;
+  params.motion_predictor = type;
+  TrackerType tracker(params);
+  CHECK(tracker.motionPredictor() != nullptr);
+
+  tracker.setTemplate(MakeImage(0.0f, 0.0f), kBox);
+  for (int k = 1; k <= 4; ++k) {
+    const Result r = tracker.Track(MakeImage(3.0f * k, 1.0f * k), static_cast<double>(k));
+    CHECK(r.successful);
+  }
+  CHECK(CornerError(kBox, tracker.motionPredictor()->predict(5.0), Translation(15.0f, 5.0f)) < 2.0f);
+
+  tracker.setTemplate(MakeImage(12.0f, 4.0f), kBox);
+  CHECK(tracker.motionPredictor()->predict(5.0).isApprox(Matrix33f::Identity()));
+  return 0;
+}
+
+int main() {
+  ConstantVelocityPredictor<Homography> constant_velocity;
+  KalmanPredictor<Homography> kalman;
+  if (TestExtrapolation(constant_velocity) || TestExtrapolation(kalman))
+    return 1;
+
+  // the Kalman filter averages the jitter out of the velocity
+  const float cv_error = JitteredError(constant_velocity), kalman_error = JitteredError(kalman);
+  std::cout << "jittered prediction error: constant velocity " << cv_error << ", kalman " << kalman_error
+            << std::endl;
+  CHECK(kalman_error < cv_error);
+
+  if (TestTracker(Parameters::MotionPredictorType::ConstantVelocity) ||
+      TestTracker(Parameters::MotionPredictorType::Kalman))
+    return 1;
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/05 15:20
+ * @Description: Test of PyramidTracker with several concurrent initializations
+ * @FilePath: Bitplanes/test/TestMultiHypothesis.cc
+ */
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+using namespace NAMESPACE;
+
+typedef PyramidTracker<Homography> TrackerType;
+
+/**
+ * I with uniform noise in [-8, 8), so that no pose matches exactly
+ */
+static cv::Mat AddNoise(const cv::Mat &I, uint32_t seed) {
+  cv::Mat ret = I.clone();
+  uint32_t s = seed;
+  for (int y = 0; y < ret.rows; ++y) {
+    for (int x = 0; x < ret.cols; ++x) {
+      s = s * 1664525u + 1013904223u;
+      const int v = ret.at<uint8_t>(y, x) + static_cast<int>(s >> 28) - 8;
+      ret.at<uint8_t>(y, x) = static_cast<uint8_t>(std::min(255, std::max(0, v)));
+    }
+  }
+  return ret;
+}
+
+int main() {
+  const cv::Rect bbox(100, 80, 100, 90);
+  const cv::Mat I0 = MakeImage(0.0f, 0.0f), I1 = MakeImage(3.0f, 2.0f);
+
+  Parameters params;
+  params.num_levels = 3;
+  params.verbose = false;
+
+  // 1.one hypothesis gives the same results as the default tracker
+  {
+    Parameters p1 = params;
+    p1.num_hypotheses = 1;
+    TrackerType a(params), b(p1);
+    a.setTemplate(I0, bbox);
+    b.setTemplate(I0, bbox);
+    for (int i = 1; i < 4; ++i) {
+      const cv::Mat I = MakeImage(0.5f * i, 0.25f * i);
+      CHECK((a.Track(I).T - b.Track(I).T).norm() < 1e-6f);
+    }
+  }
+
+  // 2.a far initialization loses the target, the previous pose run alongside
+  // it recovers it
+  const Matrix33f T_far = Translation(45.0f, -35.0f);
+  TrackerType single(params);
+  single.setTemplate(I0, bbox);
+  const Result r_single = single.Track(I1, T_far);
+  std::cout << "single: " << r_single.T(0, 2) << " " << r_single.T(1, 2) << " "
+            << ToString(r_single.status) << std::endl;
+
+  Parameters p3 = params;
+  p3.num_hypotheses = 3;
+  TrackerType multi(p3);
+  multi.setTemplate(I0, bbox);
+  const Result r_multi = multi.Track(I1, T_far);
+  std::cout << "multi: " << r_multi.T(0, 2) << " " << r_multi.T(1, 2) << " "
+            << ToString(r_multi.status) << std::endl;
+  CHECK(std::abs(r_multi.T(0, 2) - 3.0f) < 1.0f);
+  CHECK(std::abs(r_multi.T(1, 2) - 2.0f) < 1.0f);
+
+  // 3.the workspaces follow a new template
+  const cv::Rect bbox2(60, 50, 120, 100);
+  multi.setTemplate(I0, bbox2);
+  const Result r2 = multi.Track(I1, T_far);
+  CHECK(std::abs(r2.T(0, 2) - 3.0f) < 1.0f);
+  CHECK(std::abs(r2.T(1, 2) - 2.0f) < 1.0f);
+
+  // 4.an initialization that ends with the template almost out of the frame
+  // sums the residuals of a few pixels only: its sum of squares is lower than
+  // the one of the target, its cost per residual is not
+  const cv::Mat I_noisy = AddNoise(I1, 5);
+  const Matrix33f T_out = Translation(-170.0f, 100.0f);
+  TrackerType out(params);
+  out.setTemplate(I0, bbox);
+  const Result r_out = out.Track(I_noisy, T_out);
+  TrackerType target(params);
+  target.setTemplate(I0, bbox);
+  const Result r_target = target.Track(I_noisy, Matrix33f::Identity());
+  std::cout << "out of frame: ssd " << r_out.final_ssd_error << " cost " << r_out.final_cost << " visible "
+            << r_out.visible_fraction << ", target: ssd " << r_target.final_ssd_error << " cost "
+            << r_target.final_cost << std::endl;
+  CHECK(r_out.visible_fraction < 0.5f && r_out.final_ssd_error < r_target.final_ssd_error);
+  CHECK(r_target.visible_fraction == 1.0f && r_target.final_cost < r_out.final_cost);
+
+  // 4.1 run together from the template pose, the fully visible target wins
+  Parameters p2 = params;
+  p2.num_hypotheses = 2;
+  TrackerType pair(p2);
+  pair.setTemplate(I0, bbox);
+  const Result r_pair = pair.Track(I_noisy, T_out);
+  CHECK(r_pair.visible_fraction == 1.0f);
+  CHECK(std::abs(r_pair.T(0, 2) - 3.0f) < 1.0f && std::abs(r_pair.T(1, 2) - 2.0f) < 1.0f);
+
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
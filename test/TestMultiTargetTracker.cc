@@ -0,0 +1,151 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/01 14:10
+ * @Description: Tests of ThreadPool and MultiTargetTracker
+ * @FilePath: Bitplanes/test/TestMultiTargetTracker.cc
+ */
+#include "MotionModel.h"
+#include "MultiTargetTracker.h"
+#include "ThreadPool.h"
+#include "Filter.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace NAMESPACE;
+
+typedef MultiTargetTracker<Homography> MultiTrackerType;
+typedef PyramidTracker<Homography> TrackerType;
+
+static int TestThreadPool() {
+  ThreadPool pool(4);
+  CHECK(pool.numThreads() == 4);
+
+  // 1.tasks submitted from the caller
+  std::atomic<int> sum{0};
+  for (int i = 1; i <= 1000; ++i)
+    pool.submit([&sum, i]() { sum += i; });
+  pool.wait();
+  CHECK(sum == 500500);
+
+  // 2.tasks submitting tasks, wait covers the nested ones
+  sum = 0;
+  for (int i = 0; i < 16; ++i) {
+    pool.submit([&]() {
+      for (int j = 0; j < 16; ++j)
+        pool.submit([&sum]() { ++sum; });
+    });
+  }
+  pool.wait();
+  CHECK(sum == 256);
+
+  // 3.a throwing task does not stop the pool
+  pool.submit([]() { throw std::runtime_error("task"); });
+  pool.submit([&sum]() { ++sum; });
+  pool.wait();
+  CHECK(sum == 257);
+
+  // 4.tasks submitted from the caller start in the submitted order: the
+  // worker is held by the first task while the others are queued
+  ThreadPool single(1);
+  std::atomic<bool> release{false};
+  std::mutex mutex;
+  std::vector<int> started;
+  single.submit([&release]() {
+    while (!release)
+      std::this_thread::yield();
+  });
+  for (int i = 0; i < 8; ++i) {
+    single.submit([&mutex, &started, i]() {
+      std::lock_guard<std::mutex> lock(mutex);
+      started.push_back(i);
+    });
+  }
+  release = true;
+  for (;;) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (started.size() == 8)
+      break;
+  }
+  single.wait();
+  for (int i = 0; i < 8; ++i)
+    CHECK(started[i] == i);
+  return 0;
+}
+
+static int TestSameResults(const std::vector<cv::Mat> &frames, const Parameters &params) {
+  const std::vector<cv::Rect> boxes = {cv::Rect(40, 30, 60, 50), cv::Rect(150, 40, 110, 90),
+                                       cv::Rect(60, 130, 80, 80), cv::Rect(180, 150, 70, 60)};
+
+  // one tracker per target on the same shared pyramid gives the same poses
+  MultiTrackerType multi(params, 3);
+  std::vector<std::unique_ptr<TrackerType>> single;
+  for (const auto &bbox : boxes) {
+    multi.addTarget(frames[0], bbox);
+    single.emplace_back(new TrackerType(params));
+    single.back()->setTemplate(frames[0], bbox);
+  }
+  CHECK(multi.numTargets() == static_cast<int>(boxes.size()));
+
+  std::vector<cv::Mat> pyr(params.num_levels);
+  for (size_t i = 1; i < frames.size(); ++i) {
+    pyr[0] = frames[i];
+    for (int l = 1; l < params.num_levels; ++l)
+      imgproc::PyrDown(pyr[l - 1], pyr[l]);
+
+    const auto &results = multi.Track(frames[i], static_cast<double>(i));
+    CHECK(results.size() == boxes.size());
+    for (size_t k = 0; k < boxes.size(); ++k) {
+      const Result expected = single[k]->Track(pyr, static_cast<double>(i));
+      CHECK(results[k].id == static_cast<int>(k));
+      CHECK(!results[k].failed);
+      CHECK((results[k].result.T - expected.T).norm() < 1e-5f);
+    }
+  }
+  return 0;
+}
+
+static int TestAddRemove(const std::vector<cv::Mat> &frames, const Parameters &params) {
+  MultiTrackerType multi(params);
+  CHECK(multi.Track(frames[1]).empty());
+
+  const int a = multi.addTarget(frames[0], cv::Rect(40, 30, 60, 50));
+  const int b = multi.addTarget(frames[0], cv::Rect(150, 40, 110, 90));
+  CHECK(a != b);
+  CHECK(multi.tracker(b) != nullptr);
+  CHECK(multi.Track(frames[1]).size() == 2);
+
+  CHECK(multi.removeTarget(a));
+  CHECK(!multi.removeTarget(a));
+  CHECK(multi.tracker(a) == nullptr);
+
+  const int c = multi.addTarget(frames[0], cv::Rect(60, 130, 80, 80));
+  CHECK(c != a && c != b);
+  const auto &results = multi.Track(frames[2]);
+  CHECK(results.size() == 2);
+  CHECK(results[0].id == b && results[1].id == c);
+  return 0;
+}
+
+int main() {
+  std::vector<cv::Mat> frames;
+  for (int i = 0; i < 8; ++i)
+    frames.push_back(MakeImage(0.5f * i, 0.25f * i));
+
+  Parameters params;
+  params.num_levels = 3;
+  params.verbose = false;
+
+  if (TestThreadPool() || TestSameResults(frames, params) || TestAddRemove(frames, params))
+    return 1;
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
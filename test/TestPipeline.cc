@@ -0,0 +1,233 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/11 11:30
+ * @Description: Test of PipelinedTracker
+ * @FilePath: Bitplanes/test/TestPipeline.cc
+ */
+#include "MotionModel.h"
+#include "PipelinedTracker.h"
+#include "Filter.h"
+#include "Timer.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <vector>
+
+using namespace NAMESPACE;
+
+typedef PipelinedTracker<Homography> PipelineType;
+typedef PyramidTracker<Homography> TrackerType;
+
+/**
+ * the results are the ones of the serial tracker, in order, for any depth
+ */
+static int TestOrder(const Parameters &params, const cv::Mat &I0, const cv::Rect &bbox,
+                     const std::vector<cv::Mat> &frames) {
+  const std::vector<Result> expected = TrackSerial(params, I0, bbox, frames);
+  for (int depth : {1, 2, 3}) {
+    PipelineType pipeline(params, depth);
+    pipeline.setTemplate(I0, bbox);
+    PipelineType::FrameResult r;
+    CHECK(!pipeline.pop(r));
+
+    // 1.the caller pops while pushing, the results come back in push order
+    int64_t num_popped = 0;
+    for (size_t i = 0; i < frames.size(); ++i) {
+      CHECK(pipeline.push(frames[i]) == static_cast<int64_t>(i));
+      while (pipeline.tryPop(r)) {
+        CHECK(r.frame == num_popped);
+        CHECK(r.timestamp == static_cast<double>(num_popped + 1));
+        CHECK(r.image.data == frames[num_popped].data);
+        CHECK(r.result.T == expected[num_popped].T);
+        ++num_popped;
+      }
+    }
+    while (pipeline.pop(r)) {
+      CHECK(r.frame == num_popped);
+      CHECK(r.result.T == expected[num_popped].T);
+      ++num_popped;
+    }
+    CHECK(num_popped == static_cast<int64_t>(frames.size()));
+    CHECK(pipeline.pending() == 0);
+  }
+  return 0;
+}
+
+/**
+ * a new template applies to the frames pushed after it, the results of the
+ * frames before it stay available
+ */
+static int TestSetTemplate(const Parameters &params, const cv::Mat &I0, const cv::Rect &bbox,
+                           const std::vector<cv::Mat> &frames) {
+  const size_t half = frames.size() / 2;
+  const cv::Rect bbox1(bbox.x + 10, bbox.y + 5, bbox.width - 20, bbox.height - 10);
+  const std::vector<cv::Mat> second(frames.begin() + half, frames.end());
+  const std::vector<Result> expected = TrackSerial(params, frames[half - 1], bbox1, second);
+
+  PipelineType pipeline(params, 2);
+  pipeline.setTemplate(I0, bbox);
+  for (size_t i = 0; i < half; ++i)
+    pipeline.push(frames[i], static_cast<double>(i + 1));
+  pipeline.setTemplate(frames[half - 1], bbox1);
+  CHECK(pipeline.pending() == static_cast<int>(half));
+  for (size_t i = 0; i < second.size(); ++i)
+    pipeline.push(second[i], static_cast<double>(i + 1));
+
+  PipelineType::FrameResult r;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    CHECK(pipeline.pop(r));
+    CHECK(r.frame == static_cast<int64_t>(i));
+    if (i >= half)
+      CHECK(r.result.T == expected[i - half].T);
+  }
+  CHECK(!pipeline.pop(r));
+  return 0;
+}
+
+/**
+ * futures and callbacks complete in order with the results of the serial
+ * tracker, frames that did not start tracking can be cancelled
+ */
+static int TestAsync(const Parameters &params, const cv::Mat &I0, const cv::Rect &bbox,
+                     const std::vector<cv::Mat> &frames) {
+  const std::vector<Result> expected = TrackSerial(params, I0, bbox, frames);
+
+  // 1.futures, mixed with frames for pop
+  {
+    PipelineType pipeline(params, 3);
+    pipeline.setTemplate(I0, bbox);
+    std::vector<std::future<Result>> futures;
+    for (size_t i = 0; i < frames.size(); ++i) {
+      if (i % 3 == 2)
+        pipeline.push(frames[i], static_cast<double>(i + 1));
+      else
+        futures.push_back(pipeline.TrackAsync(frames[i], static_cast<double>(i + 1)));
+    }
+    for (size_t i = 0, k = 0; i < frames.size(); ++i) {
+      if (i % 3 == 2) {
+        PipelineType::FrameResult r;
+        CHECK(pipeline.pop(r));
+        CHECK(r.frame == static_cast<int64_t>(i));
+        CHECK(r.result.T == expected[i].T);
+      } else {
+        CHECK(futures[k++].get().T == expected[i].T);
+      }
+    }
+    PipelineType::FrameResult r;
+    CHECK(!pipeline.pop(r));
+  }
+
+  // 2.callbacks, on the tracking thread in frame order
+  {
+    PipelineType pipeline(params, 2);
+    pipeline.setTemplate(I0, bbox);
+    std::vector<PipelineType::FrameResult> done;
+    for (size_t i = 0; i < frames.size(); ++i)
+      pipeline.TrackAsync(frames[i], static_cast<double>(i + 1),
+                          [&done](const PipelineType::FrameResult &r) { done.push_back(r); });
+    pipeline.waitIdle();
+    CHECK(done.size() == frames.size());
+    for (size_t i = 0; i < done.size(); ++i) {
+      CHECK(done[i].frame == static_cast<int64_t>(i));
+      CHECK(done[i].image.data == frames[i].data);
+      CHECK(done[i].result.T == expected[i].T);
+    }
+  }
+
+  // 3.a first frame holds the tracking thread in its callback while the
+  // others are queued
+  {
+    PipelineType pipeline(params, 4);
+    pipeline.setTemplate(I0, bbox);
+    auto hold = [&pipeline](const cv::Mat &I, double t, std::promise<void> &entered, std::promise<void> &gate) {
+      std::shared_future<void> opened = gate.get_future().share();
+      std::promise<void> *p = &entered;
+      pipeline.TrackAsync(I, t, [p, opened](const PipelineType::FrameResult &) {
+        p->set_value();
+        opened.wait();
+      });
+      entered.get_future().wait();
+    };
+    std::promise<void> entered, gate;
+    hold(frames[0], 1.0, entered, gate);
+    std::vector<std::future<Result>> futures;
+    for (int i = 1; i < 4; ++i)
+      futures.push_back(pipeline.TrackAsync(frames[i], static_cast<double>(i + 1)));
+    CHECK(pipeline.cancelPending() == 3);
+    gate.set_value();
+    for (auto &f : futures) {
+      const Result r = f.get();
+      CHECK(r.status == OptimizerStatus::Cancelled && !r.successful);
+    }
+
+    // 4.with stale frames dropped, a new frame cancels the waiting ones
+    std::promise<void> entered2, gate2;
+    pipeline.setDropStale(true);
+    hold(frames[4], 5.0, entered2, gate2);
+    std::future<Result> stale = pipeline.TrackAsync(frames[5], 6.0);
+    std::future<Result> newest = pipeline.TrackAsync(frames[6], 7.0);
+    gate2.set_value();
+    CHECK(stale.get().status == OptimizerStatus::Cancelled);
+    const Result r = newest.get();
+    CHECK(r.status != OptimizerStatus::Cancelled && r.successful);
+  }
+
+  // 5.the frames still queued when the pipeline is destroyed are cancelled
+  std::future<Result> dropped;
+  {
+    PipelineType pipeline(params, 3);
+    pipeline.setTemplate(I0, bbox);
+    for (size_t i = 0; i + 1 < frames.size(); ++i)
+      pipeline.TrackAsync(frames[i], static_cast<double>(i + 1));
+    dropped = pipeline.TrackAsync(frames.back(), static_cast<double>(frames.size()));
+  }
+  const Result r = dropped.get();
+  CHECK(r.successful || r.status == OptimizerStatus::Cancelled);
+  return 0;
+}
+
+/**
+ * compares the time of the serial and of the pipelined processing
+ */
+static int TestThroughput(const Parameters &params, const cv::Mat &I0, const cv::Rect &bbox,
+                          const std::vector<cv::Mat> &frames) {
+  Timer timer;
+  TrackSerial(params, I0, bbox, frames);
+  const double serial_ms = timer.stop().count();
+
+  PipelineType pipeline(params, 2);
+  pipeline.setTemplate(I0, bbox);
+  timer.start();
+  PipelineType::FrameResult r;
+  for (const auto &I : frames) {
+    pipeline.push(I);
+    while (pipeline.tryPop(r)) {}
+  }
+  while (pipeline.pop(r)) {}
+  const double pipelined_ms = timer.stop().count();
+  std::cout << "serial " << serial_ms << " ms, pipelined " << pipelined_ms << " ms for " << frames.size()
+            << " frames" << std::endl;
+  CHECK(r.frame == static_cast<int64_t>(frames.size()) - 1);
+  return 0;
+}
+
+int main() {
+  Parameters params;
+  params.num_levels = 3;
+  params.verbose = false;
+  const cv::Mat I0 = MakeImage(0.0f, 0.0f);
+  const cv::Rect bbox(100, 80, 100, 90);
+  std::vector<cv::Mat> frames;
+  for (int i = 1; i <= 12; ++i)
+    frames.push_back(MakeImage(0.7f * i, 0.3f * i));
+
+  if (TestOrder(params, I0, bbox, frames) || TestSetTemplate(params, I0, bbox, frames) ||
+      TestAsync(params, I0, bbox, frames) || TestThroughput(params, I0, bbox, frames))
+    return 1;
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
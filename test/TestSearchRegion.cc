@@ -0,0 +1,113 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/15 16:40
+ * @Description: Test of the search region, Parameters::search_margin: the
+ * cropped and smoothed region gives the pose of the whole frame
+ * @FilePath: Bitplanes/test/TestSearchRegion.cc
+ */
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <iostream>
+#include <vector>
+
+using namespace NAMESPACE;
+
+/**
+ * frames of the texture moving by (vx, vy) pixels per frame
+ */
+static std::vector<cv::Mat> MakeSequence(float vx, float vy, int n) {
+  std::vector<cv::Mat> ret;
+  for (int k = 1; k <= n; ++k)
+    ret.push_back(MakeImage(vx * k, vy * k));
+  return ret;
+}
+
+/**
+ * largest corner distance between the poses tracked with the search region of
+ * margin and with the whole frame. The pyramid is built by the tracker, only
+ * in the region
+ */
+static float PyramidError(Parameters params, float margin, const cv::Rect &bbox, const std::vector<cv::Mat> &frames) {
+  const cv::Mat I0 = MakeImage(0.0f, 0.0f);
+  params.search_margin = -1.0f;
+  PyramidTracker<Homography> full(params);
+  full.setTemplate(I0, bbox);
+  params.search_margin = margin;
+  PyramidTracker<Homography> cropped(params);
+  cropped.setTemplate(I0, bbox);
+
+  float ret = 0.0f;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    const double timestamp = static_cast<double>(i + 1);
+    const Result a = full.Track(frames[i], timestamp), b = cropped.Track(frames[i], timestamp);
+    if (a.successful != b.successful)
+      return -1.0f;
+    ret = std::max(ret, CornerError(bbox, a.T, b.T));
+  }
+  return ret;
+}
+
+/**
+ * the same for a single level tracked from the previous pose
+ */
+static float TrackerError(Parameters params, float margin, const cv::Rect &bbox, const std::vector<cv::Mat> &frames) {
+  const cv::Mat I0 = MakeImage(0.0f, 0.0f);
+  params.search_margin = -1.0f;
+  Tracker<Homography> full(params);
+  full.setTemplate(I0, bbox);
+  params.search_margin = margin;
+  Tracker<Homography> cropped(params);
+  cropped.setTemplate(I0, bbox);
+
+  float ret = 0.0f;
+  Matrix33f T_full = Matrix33f::Identity(), T_cropped = Matrix33f::Identity();
+  for (const cv::Mat &I : frames) {
+    const Result a = full.Track(I, T_full), b = cropped.Track(I, T_cropped);
+    if (a.successful != b.successful)
+      return -1.0f;
+    T_full = a.T;
+    T_cropped = b.T;
+    ret = std::max(ret, CornerError(bbox, T_full, T_cropped));
+  }
+  return ret;
+}
+
+int main() {
+  Parameters params;
+  params.num_levels = 3;
+  params.max_iterations = 50;
+  params.verbose = false;
+  const float kTolerance = 1e-3f;
+
+  const cv::Rect centered(100, 80, 100, 90), border(12, 10, 100, 90);
+  const std::vector<cv::Mat> inward = MakeSequence(1.5f, 1.0f, 6), outward = MakeSequence(-2.5f, -1.5f, 8);
+
+  // the margin covers the motion of a frame, 3 pixels
+  for (float margin : {0.1f, 0.25f}) {
+    // 1.a target in the middle of the frame
+    float e = PyramidError(params, margin, centered, inward);
+    std::cout << "margin " << margin << ": pyramid " << e;
+    CHECK(e >= 0.0f && e < kTolerance);
+    e = TrackerError(params, margin, centered, inward);
+    std::cout << ", tracker " << e;
+    CHECK(e >= 0.0f && e < kTolerance);
+
+    // 2.a target at the border of the frame, where the region is clipped,
+    // moving in and partly out of the frame
+    e = PyramidError(params, margin, border, inward);
+    std::cout << ", border " << e;
+    CHECK(e >= 0.0f && e < kTolerance);
+    e = PyramidError(params, margin, border, outward);
+    std::cout << ", leaving " << e;
+    CHECK(e >= 0.0f && e < kTolerance);
+    e = TrackerError(params, margin, border, outward);
+    std::cout << ", tracker " << e << std::endl;
+    CHECK(e >= 0.0f && e < kTolerance);
+  }
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/30 17:10
+ * @Description: Benchmark of PyramidTracker::setTemplate latency
+ * @FilePath: Bitplanes/test/TestSetTemplateBenchmark.cc
+ */
+#include "MotionModel.h"
+#include "Timer.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace NAMESPACE;
+
+int main() {
+  const cv::Mat I = MakeImage(0.0f, 0.0f, 640, 480);
+
+  const int num_runs = 10;
+  printf(" levels   roi size   median [ms]\n");
+  for (int num_levels = 1; num_levels <= 4; ++num_levels) {
+    for (int roi_size : {64, 128, 256}) {
+      Parameters params;
+      params.num_levels = num_levels;
+      params.verbose = false;
+      PyramidTracker<Homography> tracker(params);
+      const cv::Rect bbox((I.cols - roi_size) / 2, (I.rows - roi_size) / 2, roi_size, roi_size);
+
+      std::vector<double> times;
+      for (int i = 0; i < num_runs; ++i) {
+        Timer timer;
+        tracker.setTemplate(I, bbox);
+        times.push_back(static_cast<double>(timer.elapsedMicroseconds().count()) / 1000.0);
+      }
+      std::nth_element(times.begin(), times.begin() + num_runs / 2, times.end());
+      printf(" %6d   %8d   %11.3f\n", num_levels, roi_size, times[num_runs / 2]);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/13 15:10
+ * @Description: Test of SpscRing, and benchmark of its latency against
+ * BoundedBuffer
+ * @FilePath: Bitplanes/test/TestSpscRing.cc
+ */
+#include "SpscRing.h"
+#include "BoundedBuffer.h"
+#include "TestUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace NAMESPACE;
+
+typedef std::chrono::steady_clock Clock;
+
+static inline int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+/**
+ * element with a swap, as BoundedBuffer::pop needs
+ */
+struct Stamp {
+  int64_t index = -1;
+  int64_t time_ns = 0;
+
+  void swap(Stamp &other) {
+    std::swap(index, other.index);
+    std::swap(time_ns, other.time_ns);
+  }
+};
+
+/**
+ * single thread behavior of the policies
+ */
+static int TestPolicies() {
+  // 1.first in first out, the capacity is rounded up
+  SpscRing<int> block(3);
+  CHECK(block.capacity() == 4);
+  int v = -1;
+  CHECK(!block.tryPop(v));
+  for (int i = 0; i < 4; ++i)
+    block.push(int(i));
+  CHECK(block.size() == 4);
+  for (int i = 0; i < 4; ++i) {
+    CHECK(block.tryPop(v) && v == i);
+  }
+  CHECK(!block.tryPop(v));
+
+  // 2.the oldest elements are replaced
+  SpscRing<int> drop(4, OverflowPolicy::DropOldest);
+  for (int i = 0; i < 10; ++i)
+    drop.push(int(i));
+  CHECK(drop.size() == 4 && drop.dropped() == 6);
+  for (int i = 6; i < 10; ++i) {
+    CHECK(drop.tryPop(v) && v == i);
+  }
+
+  // 3.only the newest element is kept
+  SpscRing<std::unique_ptr<int>> latest(4, OverflowPolicy::LatestOnly);
+  for (int i = 0; i < 10; ++i)
+    latest.push(std::unique_ptr<int>(new int(i)));
+  std::unique_ptr<int> p;
+  CHECK(latest.size() == 1 && latest.dropped() == 9);
+  CHECK(latest.tryPop(p) && *p == 9);
+  CHECK(!latest.tryPop(p));
+  return 0;
+}
+
+/**
+ * a producer and a consumer thread: every element arrives once and in order,
+ * or in increasing order with the dropping policies
+ */
+static int TestThreads() {
+  const int64_t n = 200000;
+  for (OverflowPolicy policy : {OverflowPolicy::Block, OverflowPolicy::DropOldest, OverflowPolicy::LatestOnly}) {
+    SpscRing<Stamp> ring(8, policy);
+    std::thread producer([&ring, n]() {
+      for (int64_t i = 0; i < n; ++i) {
+        Stamp s;
+        s.index = i;
+        ring.push(std::move(s));
+      }
+    });
+
+    int64_t last = -1, received = 0;
+    bool ordered = true;
+    Stamp s;
+    while (last != n - 1) {
+      ring.pop(s);
+      ordered = ordered && s.index > last;
+      last = s.index;
+      ++received;
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(received + static_cast<int64_t>(ring.dropped()) == n);
+    if (policy == OverflowPolicy::Block)
+      CHECK(received == n);
+  }
+  return 0;
+}
+
+/**
+ * time from push to pop of each element, the next element is pushed once the
+ * previous one is taken so that the queueing time is left out
+ */
+template<class Push, class Pop>
+static std::vector<double> Latencies(int64_t n, Push push, Pop pop) {
+  std::vector<double> ret;
+  ret.reserve(n);
+  std::atomic<int64_t> num_popped{0};
+  std::thread producer([&push, &num_popped, n]() {
+    for (int64_t i = 0; i < n; ++i) {
+      while (num_popped.load(std::memory_order_acquire) < i)
+        std::this_thread::yield();
+      Stamp s;
+      s.index = i;
+      s.time_ns = NowNs();
+      push(s);
+    }
+  });
+  Stamp s;
+  for (int64_t i = 0; i < n; ++i) {
+    while (!pop(s))
+      std::this_thread::yield();
+    ret.push_back(static_cast<double>(NowNs() - s.time_ns) / 1000.0);
+    num_popped.store(i + 1, std::memory_order_release);
+  }
+  producer.join();
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+/**
+ * age of the frames taken by a consumer slower than the producer
+ */
+template<class Push, class Pop>
+static double MeanAgeMs(int num_frames, Push push, Pop pop) {
+  std::thread producer([&push, num_frames]() {
+    for (int i = 0; i < num_frames; ++i) {
+      Stamp s;
+      s.index = i;
+      s.time_ns = NowNs();
+      push(s);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+  double sum = 0.0;
+  int n = 0;
+  Stamp s;
+  while (s.index != num_frames - 1) {
+    if (!pop(s))
+      continue;
+    sum += static_cast<double>(NowNs() - s.time_ns) / 1e6;
+    ++n;
+    std::this_thread::sleep_for(std::chrono::milliseconds(3));  // tracking
+  }
+  producer.join();
+  return sum / std::max(1, n);
+}
+
+static void Benchmark() {
+  const int64_t n = 20000;
+  printf("          push to pop latency [us]\n");
+  printf("                     median      p99\n");
+  {
+    BoundedBuffer<Stamp> buffer(10);
+    auto v = Latencies(n, [&buffer](Stamp &s) { buffer.push(std::move(s)); },
+                       [&buffer](Stamp &s) { return buffer.pop(&s); });
+    printf(" BoundedBuffer   %10.2f %8.2f\n", v[n / 2], v[n * 99 / 100]);
+  }
+  {
+    SpscRing<Stamp> ring(16);
+    auto v = Latencies(n, [&ring](Stamp &s) { ring.push(std::move(s)); },
+                       [&ring](Stamp &s) { return ring.tryPop(s); });
+    printf(" SpscRing        %10.2f %8.2f\n", v[n / 2], v[n * 99 / 100]);
+  }
+
+  // frames queued behind a slower consumer add to the latency
+  const int num_frames = 300;
+  printf("\n          frame age, 1 ms capture, 3 ms tracking\n");
+  {
+    BoundedBuffer<Stamp> buffer(10);
+    const double age = MeanAgeMs(num_frames, [&buffer](Stamp &s) { buffer.push(std::move(s)); },
+                                 [&buffer](Stamp &s) { return buffer.pop(&s); });
+    printf(" BoundedBuffer(10)      %8.2f ms\n", age);
+  }
+  {
+    SpscRing<Stamp> ring(16, OverflowPolicy::LatestOnly);
+    const double age = MeanAgeMs(num_frames, [&ring](Stamp &s) { ring.push(std::move(s)); },
+                                 [&ring](Stamp &s) { return ring.tryPop(s); });
+    printf(" SpscRing LatestOnly    %8.2f ms\n", age);
+  }
+}
+
+int main() {
+  if (TestPolicies() || TestThreads())
+    return 1;
+  Benchmark();
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
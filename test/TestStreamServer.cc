@@ -0,0 +1,167 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/04 11:00
+ * @Description: Tests of StreamServer: results, earliest deadline first
+ * scheduling and frame dropping
+ * @FilePath: Bitplanes/test/TestStreamServer.cc
+ */
+#include "MotionModel.h"
+#include "StreamServer.h"
+#include "Filter.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace NAMESPACE;
+
+typedef StreamServer<Homography> ServerType;
+typedef PyramidTracker<Homography> TrackerType;
+
+/**
+ * every frame is tracked, in order, with the same results as a tracker per
+ * target on the shared pyramid
+ */
+static int TestResults(const std::vector<cv::Mat> &frames, const Parameters &params) {
+  const std::vector<cv::Rect> boxes = {cv::Rect(40, 30, 60, 50), cv::Rect(150, 40, 110, 90)};
+  const int num_streams = 3, n = static_cast<int>(frames.size());
+
+  std::mutex mutex;
+  std::vector<std::vector<Matrix33f, Eigen::aligned_allocator<Matrix33f>>> poses(num_streams);
+  std::vector<std::vector<int64_t>> indices(num_streams);
+  {
+    ServerType server(params, 2);
+    for (int k = 0; k < num_streams; ++k) {
+      const auto id = server.addStream(1e6f, [&, k](const ServerType::FrameResult &r) {
+        std::lock_guard<std::mutex> lock(mutex);
+        indices[k].push_back(r.frame);
+        for (const auto &res : r.results)
+          poses[k].push_back(res.T);
+      }, n);
+      CHECK(id == k);
+      for (const auto &bbox : boxes)
+        server.addTarget(id, frames[0], bbox);
+    }
+
+    for (int i = 1; i < n; ++i)
+      for (int k = 0; k < num_streams; ++k)
+        CHECK(server.submit(k, frames[i], static_cast<double>(i)));
+    CHECK(!server.submit(num_streams, frames[1], 1.0));
+    server.waitIdle();
+
+    for (int k = 0; k < num_streams; ++k) {
+      const auto stats = server.stats(k);
+      CHECK(stats.submitted == n - 1);
+      CHECK(stats.processed == n - 1);
+      CHECK(stats.dropped == 0);
+      CHECK(stats.max_latency_ms >= stats.mean_latency_ms);
+    }
+  }
+
+  // reference
+  std::vector<cv::Mat> pyr(params.num_levels);
+  std::vector<Matrix33f, Eigen::aligned_allocator<Matrix33f>> expected;
+  std::vector<std::unique_ptr<TrackerType>> single;
+  for (const auto &bbox : boxes) {
+    single.emplace_back(new TrackerType(params));
+    single.back()->setTemplate(frames[0], bbox);
+  }
+  for (int i = 1; i < n; ++i) {
+    pyr[0] = frames[i];
+    for (int l = 1; l < params.num_levels; ++l)
+      imgproc::PyrDown(pyr[l - 1], pyr[l]);
+    for (auto &t : single)
+      expected.push_back(t->Track(pyr, static_cast<double>(i)).T);
+  }
+
+  for (int k = 0; k < num_streams; ++k) {
+    CHECK(indices[k].size() == static_cast<size_t>(n - 1));
+    for (int i = 0; i < n - 1; ++i)
+      CHECK(indices[k][i] == i);
+    CHECK(poses[k].size() == expected.size());
+    for (size_t j = 0; j < expected.size(); ++j)
+      CHECK((poses[k][j] - expected[j]).norm() < 1e-5f);
+  }
+  return 0;
+}
+
+/**
+ * with one worker busy, the frame with the earliest deadline runs first, and
+ * a stream that falls behind keeps only its latest frame
+ */
+static int TestScheduling(const std::vector<cv::Mat> &frames, const Parameters &params) {
+  ServerType server(params, 1);
+  std::mutex mutex;
+  std::vector<int> order;
+  std::vector<int64_t> late_frames;
+  std::atomic<bool> blocked{false}, release{false};
+
+  const auto blocker = server.addStream(1e6f, [&](const ServerType::FrameResult &) {
+    blocked = true;
+    while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  });
+  const auto relaxed = server.addStream(1e6f, [&](const ServerType::FrameResult &) {
+    std::lock_guard<std::mutex> lock(mutex);
+    order.push_back(1);
+  });
+  const auto urgent = server.addStream(20.0f, [&](const ServerType::FrameResult &r) {
+    std::lock_guard<std::mutex> lock(mutex);
+    order.push_back(2);
+    late_frames.push_back(r.frame);
+  });
+  server.addTarget(relaxed, frames[0], cv::Rect(40, 30, 60, 50));
+  server.addTarget(urgent, frames[0], cv::Rect(150, 40, 110, 90));
+
+  // 1.the worker is held by the blocker while the other frames are queued,
+  // until the deadline of the urgent stream has passed
+  server.submit(blocker, frames[1], 1.0);
+  while (!blocked) std::this_thread::yield();
+  server.submit(relaxed, frames[1], 1.0);
+  for (int i = 1; i <= 3; ++i)
+    server.submit(urgent, frames[i], static_cast<double>(i));
+  std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  release = true;
+  server.waitIdle();
+
+  // 2.urgent first, and only its latest frame
+  CHECK(order.size() == 2);
+  CHECK(order[0] == 2 && order[1] == 1);
+  CHECK(late_frames.size() == 1 && late_frames[0] == 2);
+
+  const auto stats = server.stats(urgent);
+  CHECK(stats.submitted == 3);
+  CHECK(stats.processed == 1);
+  CHECK(stats.dropped == 2);
+  CHECK(stats.deadline_misses == 1);
+  CHECK(server.stats(relaxed).deadline_misses == 0);
+
+  // 3.removed streams take no frames
+  CHECK(server.removeStream(urgent));
+  CHECK(!server.removeStream(urgent));
+  CHECK(!server.submit(urgent, frames[1], 4.0));
+  CHECK(server.addTarget(urgent, frames[0], cv::Rect(150, 40, 110, 90)) == -1);
+  return 0;
+}
+
+int main() {
+  std::vector<cv::Mat> frames;
+  for (int i = 0; i < 6; ++i)
+    frames.push_back(MakeImage(0.5f * i, 0.25f * i));
+
+  Parameters params;
+  params.num_levels = 3;
+  params.verbose = false;
+
+  if (TestResults(frames, params) || TestScheduling(frames, params))
+    return 1;
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/29 16:20
+ * @Description: Test PyramidTracker::setTemplateAsync
+ * @FilePath: Bitplanes/test/TestTemplateAsync.cc
+ */
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <iostream>
+
+using namespace NAMESPACE;
+
+int main() {
+  Parameters params;
+  params.num_levels = 3;
+  params.verbose = false;
+  PyramidTracker<Homography> tracker(params);
+
+  const cv::Mat I0 = MakeImage(0.0f, 0.0f), I1 = MakeImage(3.0f, 2.0f);
+  const cv::Rect bbox(110, 70, 100, 100);
+  tracker.setTemplate(I0, bbox);
+
+  // 1.the new template is built in the background, tracking keeps running
+  cv::Mat I = I1.clone();
+  tracker.setTemplateAsync(I, bbox);
+  I.setTo(0);
+  CHECK(tracker.hasPendingTemplate());
+
+  // 2.once swapped in, poses are relative to the new template
+  tracker.waitForTemplate();
+  CHECK(!tracker.hasPendingTemplate());
+  auto ret = tracker.Track(I1, Matrix33f::Identity());
+  CHECK(std::fabs(ret.T(0, 2)) < 0.1f && std::fabs(ret.T(1, 2)) < 0.1f);
+
+  // 3.Track swaps the template in between frames, superseded templates are dropped
+  tracker.setTemplateAsync(I1, bbox);
+  tracker.setTemplateAsync(I0, bbox);
+  int num_frames = 0;
+  while (tracker.hasPendingTemplate() && num_frames < 1000) {
+    tracker.Track(I1);
+    ++num_frames;
+  }
+  CHECK(!tracker.hasPendingTemplate());
+  ret = tracker.Track(I1, Matrix33f::Identity());
+  CHECK(std::fabs(ret.T(0, 2) - 3.0f) < 0.5f && std::fabs(ret.T(1, 2) - 2.0f) < 0.5f);
+
+  std::cout << "Swapped after " << num_frames << " frames" << std::endl;
+  return 0;
+}
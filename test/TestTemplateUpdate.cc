@@ -0,0 +1,63 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/30 10:40
+ * @Description: Test Tracker::updateTemplate
+ * @FilePath: Bitplanes/test/TestTemplateUpdate.cc
+ */
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <iostream>
+
+using namespace NAMESPACE;
+
+/**
+ * relative difference of the hessians
+ */
+template<class H>
+static float Diff(const H &a, const H &b) {
+  return (a - b).norm() / std::max(1e-6f, b.norm());
+}
+
+int main() {
+  typedef Tracker<Homography> TrackerType;
+  Parameters params;
+  params.verbose = false;
+  params.subsampling = 2;
+
+  const cv::Mat A = MakeImage(0.0f, 0.0f), B = MakeImage(17.0f, 11.0f);
+  const cv::Rect bbox(110, 70, 101, 99);
+
+  TrackerType tracker(params), reference(params);
+  tracker.setTemplate(A, bbox);
+  reference.setTemplate(B, bbox);
+
+  // 1.a partial update keeps the hessian equal to J^T J of the updated jacobians
+  const int n = tracker.updateTemplate(B, cv::Rect(bbox.x + 13, bbox.y + 20, 40, 31));
+  CHECK(n > 0 && n < static_cast<int>(tracker.channelData().pixels().size()));
+  const auto &J = tracker.channelData().jacobian();
+  const TrackerType::Hessian JtJ = J.transpose() * J;
+  CHECK(Diff(tracker.channelData().hessian(), JtJ) < 1e-4f);
+
+  // 2.updating the rest of the template gives the template of B
+  tracker.updateTemplate(B, bbox);
+  CHECK(Diff(tracker.channelData().hessian(), reference.channelData().hessian()) < 1e-4f);
+  CHECK((tracker.channelData().jacobian() - reference.channelData().jacobian()).norm() < 1e-3f);
+  CHECK(tracker.channelData().pixels() == reference.channelData().pixels());
+
+  // 3.regions outside the template do not change anything
+  CHECK(tracker.updateTemplate(A, cv::Rect(0, 0, 50, 50)) == 0);
+
+  // 4.the pyramid updates every level
+  params.num_levels = 3;
+  PyramidTracker<Homography> pyramid(params);
+  pyramid.setTemplate(A, bbox);
+  CHECK(pyramid.updateTemplate(B, bbox) == static_cast<int>(tracker.channelData().pixels().size()));
+
+  std::cout << "Updated " << n << " pixels" << std::endl;
+  return 0;
+}
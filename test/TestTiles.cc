@@ -0,0 +1,129 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/06 14:30
+ * @Description: Test of the tiled template: per-tile linearization and
+ * rejection of occluded tiles
+ * @FilePath: Bitplanes/test/TestTiles.cc
+ */
+#include "ChannelDataSampler.h"
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace NAMESPACE;
+
+typedef ChannelDataSampler<Homography> Sampler;
+
+/**
+ * the tiles add up to the whole template
+ */
+static int TestSampler(const cv::Mat &I) {
+  const cv::Rect roi(60, 40, 151, 122);
+  for (int sub_sampling : {1, 2}) {
+    for (int tile_size : {16, 33}) {
+      Sampler sampler(sub_sampling);
+      sampler.setTileSize(tile_size);
+      Matrix33f T, T_inv;
+      sampler.getNormedCoordinate(roi, T, T_inv);
+      const int n = sampler.NumPixels(roi);
+      Arena arena;
+      arena.reserve(sampler.BufferSize(roi) + 2 * Arena::Bytes<float>(8 * n));
+      sampler.set(I, roi, arena, T(0, 0), T_inv(0, 2), T_inv(1, 2));
+      CHECK(sampler.numTiles() > 1);
+
+      // 1.hessians and pixel counts
+      Homography::Hessian H = Homography::Hessian::Zero();
+      int num_pixels = 0;
+      for (int t = 0; t < sampler.numTiles(); ++t) {
+        H += sampler.tileHessian(t);
+        num_pixels += sampler.tilePixels(t);
+      }
+      CHECK(num_pixels == n);
+      CHECK((H - sampler.hessian()).norm() < 1e-4f * H.norm());
+
+      // 2.gradients and residuals
+      const cv::Mat Iw = I(roi + cv::Point(2, 1)).clone();
+      Sampler::Residuals r0(arena.allocate<float>(8 * n), 8 * n), r1(arena.allocate<float>(8 * n), 8 * n);
+      Homography::Gradient g0;
+      const float sum_sq0 = sampler.ComputeResidualsAndGradient(Iw, r0, g0);
+
+      EigenStdVector<Homography::Gradient>::type g(sampler.numTiles());
+      std::vector<float> sum_sq(sampler.numTiles());
+      sampler.ComputeTileResidualsAndGradients(Iw, r1, g.data(), sum_sq.data());
+      Homography::Gradient g1 = Homography::Gradient::Zero();
+      float sum_sq1 = 0.0f;
+      for (int t = 0; t < sampler.numTiles(); ++t) {
+        g1 += g[t];
+        sum_sq1 += sum_sq[t];
+      }
+      CHECK(r0 == r1);
+      CHECK((g1 - g0).norm() < 1e-4f * std::max(1.0f, g0.norm()));
+      CHECK(std::fabs(sum_sq1 - sum_sq0) < 1e-3f);
+
+      // 3.an updated region updates the hessians of its tiles
+      sampler.update(MakeImage(1.0f, 0.0f), cv::Point(0, 0), cv::Rect(80, 60, 20, 20));
+      H.setZero();
+      for (int t = 0; t < sampler.numTiles(); ++t)
+        H += sampler.tileHessian(t);
+      CHECK((H - sampler.hessian()).norm() < 1e-4f * H.norm());
+    }
+  }
+  return 0;
+}
+
+/**
+ * an occluder over part of the template is dropped from the solve
+ */
+static int TestOcclusion(const cv::Mat &I0) {
+  const cv::Rect bbox(100, 80, 100, 90);
+  cv::Mat I1 = MakeImage(3.0f, 2.0f);
+
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> dist(0, 255);
+  for (int y = bbox.y + 40; y < bbox.y + 95; ++y)
+    for (int x = bbox.x + 55; x < bbox.x + 105; ++x)
+      I1.at<uint8_t>(y, x) = static_cast<uint8_t>(dist(rng));
+
+  Parameters params;
+  params.num_levels = 1;
+  params.verbose = false;
+  Tracker<Homography> whole(params);
+  whole.setTemplate(I0, bbox);
+  const Result r_whole = whole.Track(I1);
+
+  params.tile_size = 16;
+  Tracker<Homography> tiled(params);
+  tiled.setTemplate(I0, bbox);
+  const Result r_tiled = tiled.Track(I1);
+
+  // 1.the same tracker on the frame without the occluder keeps all the tiles
+  const Result r_clean = tiled.Track(MakeImage(3.0f, 2.0f));
+  CHECK(r_clean.dropped_tiles == 0);
+
+  // 2.the occluded tiles are dropped, the pose stays close to the one without
+  // the occluder, closer than without tiles, in fewer iterations
+  const float e_whole = (r_whole.T - r_clean.T).norm(), e_tiled = (r_tiled.T - r_clean.T).norm();
+  std::cout << "whole: error " << e_whole << ", " << r_whole.num_iterations << " iterations\n"
+            << "tiled: error " << e_tiled << ", " << r_tiled.num_iterations << " iterations, "
+            << r_tiled.dropped_tiles << " tiles dropped" << std::endl;
+  CHECK(r_whole.dropped_tiles == 0);
+  CHECK(r_tiled.dropped_tiles > 0);
+  CHECK(e_tiled < 0.5f);
+  CHECK(e_tiled < e_whole);
+  CHECK(r_tiled.num_iterations <= r_whole.num_iterations);
+  return 0;
+}
+
+int main() {
+  const cv::Mat I = MakeImage(0.0f, 0.0f);
+  if (TestSampler(I) || TestOcclusion(I))
+    return 1;
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/15 13:30
+ * @Description: Test of the time budget of Track, Parameters::max_time_us
+ * @FilePath: Bitplanes/test/TestTimeBudget.cc
+ */
+#include "MotionModel.h"
+#include "Timer.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <iostream>
+
+using namespace NAMESPACE;
+
+/**
+ * a single level stops after the first linearization, at the initial pose
+ */
+static int TestTracker(Parameters params, const cv::Mat &I0, const cv::Mat &I1, const cv::Rect &bbox) {
+  Tracker<Homography> tracker(params);
+  tracker.setTemplate(I0, bbox);
+
+  // 1.without budget the optimization iterates
+  const Result full = tracker.Track(I1, Matrix33f::Identity());
+  CHECK(full.status != OptimizerStatus::TimeBudgetExceeded && full.num_iterations > 2);
+
+  // 2.a budget of 1 us is spent by the first linearization
+  const Result r = tracker.Track(I1, Matrix33f::Identity(), 1.0f);
+  CHECK(r.status == OptimizerStatus::TimeBudgetExceeded);
+  CHECK(r.num_iterations == 1);
+  CHECK(r.T.isApprox(Matrix33f::Identity()));
+  return 0;
+}
+
+/**
+ * the pyramid gives up after one level, the coarsest, and returns before the
+ * unbudgeted frame would. With any budget, the result is at the last level
+ * that was tracked
+ */
+static int TestPyramid(Parameters params, const cv::Mat &I0, const cv::Mat &I1, const cv::Rect &bbox) {
+  PyramidTracker<Homography> tracker(params);
+  tracker.setTemplate(I0, bbox);
+  params.max_time_us = 1.0f;
+  PyramidTracker<Homography> limited(params);
+  limited.setTemplate(I0, bbox);
+
+  Timer timer;
+  const Result full = tracker.Track(I1, Matrix33f::Identity());
+  const double full_us = static_cast<double>(timer.elapsedMicroseconds().count());
+  CHECK(full.status != OptimizerStatus::TimeBudgetExceeded && full.num_levels == params.num_levels);
+
+  timer.start();
+  const Result r = limited.Track(I1, Matrix33f::Identity());
+  const double limited_us = static_cast<double>(timer.elapsedMicroseconds().count());
+  std::cout << "unbudgeted " << full_us << " us, 1 us budget " << limited_us << " us" << std::endl;
+  CHECK(r.status == OptimizerStatus::TimeBudgetExceeded);
+  CHECK(r.num_levels == 1 && r.level == params.num_levels - 1);
+  CHECK(r.T.allFinite());
+  CHECK(limited_us < full_us);
+
+  // the levels run are [level, num_levels - 1], all of them when the budget
+  // lasts
+  for (float budget_us : {1.0f, 30.0f, 100.0f, 300.0f, 1000.0f, 3000.0f, 1e6f}) {
+    params.max_time_us = budget_us;
+    PyramidTracker<Homography> budgeted(params);
+    budgeted.setTemplate(I0, bbox);
+    const Result b = budgeted.Track(I1, Matrix33f::Identity());
+    CHECK(b.num_levels >= 1 && b.level + b.num_levels == params.num_levels);
+    CHECK(b.status == OptimizerStatus::TimeBudgetExceeded || b.level == 0);
+    CHECK(b.T.allFinite());
+  }
+  return 0;
+}
+
+int main() {
+  Parameters params;
+  params.num_levels = 3;
+  params.max_iterations = 50;
+  params.verbose = false;
+  const cv::Rect bbox(100, 80, 100, 90);
+  const cv::Mat I0 = MakeImage(0.0f, 0.0f), I1 = MakeImage(3.0f, 2.0f);
+
+  if (TestTracker(params, I0, I1, bbox) || TestPyramid(params, I0, I1, bbox))
+    return 1;
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/12 15:40
+ * @Description: Test of the two-rate tracking: coarse result right away,
+ * refinement at level 0 on a worker thread
+ * @FilePath: Bitplanes/test/TestTwoRate.cc
+ */
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "Filter.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+using namespace NAMESPACE;
+
+typedef PyramidTracker<Homography> TrackerType;
+
+/**
+ * a refined frame that is waited for gives the result of Track, and the next
+ * frame starts from it
+ */
+static int TestRefined(const Parameters &params, const cv::Mat &I0, const cv::Rect &bbox,
+                       const std::vector<cv::Mat> &frames) {
+  TrackerType serial(params), two_rate(params);
+  serial.setTemplate(I0, bbox);
+  two_rate.setTemplate(I0, bbox);
+
+  Result refined;
+  double refined_time = -1.0;
+  int num_refined = 0;
+  CHECK(!two_rate.refinedResult(refined, refined_time));
+  for (size_t i = 0; i < frames.size(); ++i) {
+    const double t = static_cast<double>(i + 1);
+    const Result expected = serial.Track(frames[i], t);
+    CHECK(expected.level == 0);
+
+    const Result coarse = two_rate.TrackCoarse(frames[i], t, [&](const Result &r, double timestamp) {
+      refined = r;
+      refined_time = timestamp;
+      ++num_refined;
+    });
+    CHECK(coarse.level == 1);
+    two_rate.waitForRefinement();
+    CHECK(num_refined == static_cast<int>(i + 1));
+    CHECK(refined_time == t);
+    CHECK(refined.level == 0);
+    CHECK(refined.T == expected.T);
+
+    Result last;
+    double last_time;
+    CHECK(two_rate.refinedResult(last, last_time));
+    CHECK(last.T == refined.T && last_time == t);
+  }
+
+  // a synchronous Track after TrackCoarse waits for the refinement
+  CHECK(two_rate.Track(frames[0], 100.0).T == serial.Track(frames[0], 100.0).T);
+  return 0;
+}
+
+/**
+ * without waiting, the refinements are published in frame order, the ones
+ * superseded are skipped, and the last frame is refined
+ */
+static int TestUnwaited(const Parameters &params, const cv::Mat &I0, const cv::Rect &bbox,
+                        const std::vector<cv::Mat> &frames) {
+  TrackerType serial(params), two_rate(params);
+  serial.setTemplate(I0, bbox);
+  two_rate.setTemplate(I0, bbox);
+
+  std::mutex mutex;
+  std::vector<double> times;
+  Result last;
+  Result expected;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    const double t = static_cast<double>(i + 1);
+    expected = serial.Track(frames[i], t);
+    two_rate.TrackCoarse(frames[i], t, [&](const Result &r, double timestamp) {
+      std::lock_guard<std::mutex> lock(mutex);
+      times.push_back(timestamp);
+      last = r;
+    });
+  }
+  two_rate.waitForRefinement();
+  std::cout << times.size() << " of " << frames.size() << " frames refined" << std::endl;
+  CHECK(!times.empty() && times.back() == static_cast<double>(frames.size()));
+  for (size_t i = 1; i < times.size(); ++i)
+    CHECK(times[i] > times[i - 1]);
+  CHECK((last.T.col(2) - expected.T.col(2)).norm() < 1.0f);
+
+  // a new template drops the refinements of the old one
+  two_rate.setTemplate(I0, bbox);
+  Result r;
+  double t;
+  CHECK(!two_rate.refinedResult(r, t));
+  return 0;
+}
+
+/**
+ * the frame can be reused right after TrackCoarse, as a capture loop does:
+ * the refinement works on its own copy
+ */
+static int TestReusedFrame(const Parameters &params, const cv::Mat &I0, const cv::Rect &bbox,
+                           const std::vector<cv::Mat> &frames) {
+  TrackerType serial(params), two_rate(params);
+  serial.setTemplate(I0, bbox);
+  two_rate.setTemplate(I0, bbox);
+
+  cv::Mat buf;
+  Result refined;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    const double t = static_cast<double>(i + 1);
+    const Result expected = serial.Track(frames[i], t);
+    frames[i].copyTo(buf);
+    two_rate.TrackCoarse(buf, t, [&refined](const Result &r, double) { refined = r; });
+    buf.setTo(0);
+    two_rate.waitForRefinement();
+    CHECK(refined.T == expected.T);
+  }
+  return 0;
+}
+
+/**
+ * a single level has nothing to refine
+ */
+static int TestSingleLevel(Parameters params, const cv::Mat &I0, const cv::Rect &bbox,
+                           const std::vector<cv::Mat> &frames) {
+  params.num_levels = 1;
+  TrackerType tracker(params);
+  tracker.setTemplate(I0, bbox);
+  int num_refined = 0;
+  const Result r = tracker.TrackCoarse(frames[0], 1.0, [&](const Result &, double) { ++num_refined; });
+  tracker.waitForRefinement();
+  CHECK(r.level == 0);
+  CHECK(num_refined == 0);
+  return 0;
+}
+
+int main() {
+  Parameters params;
+  params.num_levels = 3;
+  params.verbose = false;
+  const cv::Mat I0 = MakeImage(0.0f, 0.0f);
+  const cv::Rect bbox(100, 80, 100, 90);
+  std::vector<cv::Mat> frames;
+  for (int i = 1; i <= 8; ++i)
+    frames.push_back(MakeImage(0.7f * i, 0.3f * i));
+
+  if (TestRefined(params, I0, bbox, frames) || TestUnwaited(params, I0, bbox, frames) ||
+      TestReusedFrame(params, I0, bbox, frames) || TestSingleLevel(params, I0, bbox, frames))
+    return 1;
+  std::cout << "all tests passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/12/15 09:40
+ * @Description: Fixtures shared by the tests
+ * @FilePath: Bitplanes/test/TestUtils.h
+ */
+#pragma once
+
+#include "Filter.h"
+#include "MotionModel.h"
+#include "Tracker.h"
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+/**
+ * returns 1 from the enclosing function when cond does not hold
+ */
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      std::cout << __LINE__ << ": CHECK failed: " #cond << std::endl;      \
+      return 1;                                                            \
+    }                                                                      \
+  } while (0)
+
+/**
+ * smooth texture shifted by (dx, dy) pixels
+ */
+static inline cv::Mat MakeImage(float dx, float dy, int cols = 320, int rows = 240) {
+  cv::Mat I(rows, cols, CV_8UC1);
+  for (int y = 0; y < I.rows; ++y) {
+    for (int x = 0; x < I.cols; ++x) {
+      const float u = static_cast<float>(x) - dx, v = static_cast<float>(y) - dy;
+      I.at<uint8_t>(y, x) = static_cast<uint8_t>(128.0f + 60.0f * std::sin(0.11f * u) * std::cos(0.07f * v) +
+                                                 30.0f * std::sin(0.05f * u + 0.13f * v));
+    }
+  }
+  return I;
+}
+
+/**
+ * homography of a translation
+ */
+static inline NAMESPACE::Matrix33f Translation(float tx, float ty) {
+  NAMESPACE::Matrix33f T = NAMESPACE::Matrix33f::Identity();
+  T(0, 2) = tx;
+  T(1, 2) = ty;
+  return T;
+}
+
+/**
+ * largest distance between the corners of r warped by H0 and by H1
+ */
+static inline float CornerError(const cv::Rect &r, const NAMESPACE::Matrix33f &H0, const NAMESPACE::Matrix33f &H1) {
+  const float xs[] = {static_cast<float>(r.x), static_cast<float>(r.x + r.width)};
+  const float ys[] = {static_cast<float>(r.y), static_cast<float>(r.y + r.height)};
+  float ret = 0.0f;
+  for (float x : xs) {
+    for (float y : ys) {
+      const Eigen::Vector3f p0 = H0 * Eigen::Vector3f(x, y, 1.0f), p1 = H1 * Eigen::Vector3f(x, y, 1.0f);
+      ret = std::max(ret, (p0.head<2>() / p0[2] - p1.head<2>() / p1[2]).norm());
+    }
+  }
+  return ret;
+}
+
+/**
+ * the frames tracked one after the other on their full pyramid, the frame i
+ * with the timestamp i + 1
+ */
+static inline std::vector<NAMESPACE::Result> TrackSerial(const NAMESPACE::Parameters &params, const cv::Mat &I0,
+                                                         const cv::Rect &bbox, const std::vector<cv::Mat> &frames) {
+  NAMESPACE::PyramidTracker<NAMESPACE::Homography> tracker(params);
+  tracker.setTemplate(I0, bbox);
+  std::vector<NAMESPACE::Result> ret;
+  std::vector<cv::Mat> pyr(tracker.numLevels());
+  for (size_t i = 0; i < frames.size(); ++i) {
+    pyr[0] = frames[i];
+    for (int l = 1; l < tracker.numLevels(); ++l)
+      NAMESPACE::imgproc::PyrDown(pyr[l - 1], pyr[l]);
+    ret.push_back(tracker.Track(pyr, static_cast<double>(i + 1)));
+  }
+  return ret;
+}
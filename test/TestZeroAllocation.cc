@@ -0,0 +1,83 @@
+/*
+ * @Author: chenjingyu
+ * @Contact: 2458006366@qq.com
+ * @Date: 2023/11/28 16:10
+ * @Description: Checks that tracking does not allocate after the first frame
+ * @FilePath: Bitplanes/test/TestZeroAllocation.cc
+ */
+#include "MotionModel.h"
+#include "Tracker.h"
+#include "TestUtils.h"
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+static std::atomic<bool> g_count_allocations{false};
+static std::atomic<size_t> g_num_allocations{0};
+
+static void *Allocate(size_t n) {
+  if (g_count_allocations)
+    ++g_num_allocations;
+  void *p = std::malloc(n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new(size_t n) { return Allocate(n); }
+void *operator new[](size_t n) { return Allocate(n); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+using namespace NAMESPACE;
+
+int main() {
+  const int rows = 240, cols = 320, num_frames = 20;
+
+  // 1.PyrDown gives the same levels as cv::pyrDown, also for odd sizes
+  for (const cv::Size &size : {cv::Size(cols, rows), cv::Size(161, 121), cv::Size(7, 5), cv::Size(2, 1)}) {
+    const cv::Mat I = MakeImage(0.0f, 0.0f, size.width, size.height);
+    cv::Mat a, b;
+    imgproc::PyrDown(I, a);
+    cv::pyrDown(I, b);
+    CHECK(a.size() == b.size() && cv::norm(a, b, cv::NORM_INF) == 0.0);
+  }
+
+  // 2.Prepare the frames
+  std::vector<cv::Mat> frames;
+  for (int i = 0; i <= num_frames; ++i)
+    frames.push_back(MakeImage(0.5f * i, 0.25f * i, cols, rows));
+
+  // 3.Initialize the Tracker
+  Parameters params;
+  params.num_levels = 3;
+  params.max_iterations = 50;
+  params.verbose = false;
+  params.search_margin = 0.5f;
+  params.adaptive_levels = true;
+  params.motion_predictor = Parameters::MotionPredictorType::ConstantVelocity;
+  params.max_time_us = 1e6f;
+  PyramidTracker<Homography> tracker(params);
+  tracker.setTemplate(frames[0], cv::Rect(110, 70, 100, 100));
+
+  // 4.The first frame may allocate
+  Matrix33f T = tracker.Track(frames[1], Matrix33f::Identity()).T;
+
+  // 5.Count allocations of the remaining frames, the pyramid of each frame is
+  // built by Track into the levels reserved at setTemplate
+  g_count_allocations = true;
+  for (int i = 2; i <= num_frames; ++i)
+    T = tracker.Track(frames[i], T).T;
+  g_count_allocations = false;
+
+  const size_t n = g_num_allocations;
+  std::cout << "Allocations after the first frame: " << n << std::endl;
+  return n == 0 ? 0 : 1;
+}